@@ -0,0 +1,90 @@
+// Copyright (c) 2026 The Permory contributors
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt.)
+
+#ifndef permory_detail_aligned_matrix_hpp
+#define permory_detail_aligned_matrix_hpp
+
+#include <algorithm>
+#include <vector>
+
+namespace Permory { namespace detail {
+
+    //
+    // Matrix stored row by row in one contiguous block of memory. Each row
+    // starts at a 64 byte (cache line) boundary and is padded with T() up to
+    // the next one, which allows vectorized loops over rows to use aligned
+    // loads and no row to share a cache line with another one.
+    //
+    template<class T> class Aligned_matrix {
+        public:
+            // Ctor
+            Aligned_matrix(size_t r=0, size_t c=0) { init(r, c); }
+            Aligned_matrix(const Aligned_matrix& m) {
+                init(m.nrow_, m.ncol_);
+                std::copy(m.begin(), m.end(), begin());
+            }
+
+            // Inspection
+            bool empty() const { return nrow_ == 0; }
+            size_t nrow() const { return nrow_; }
+            size_t ncol() const { return ncol_; }
+            size_t stride() const { return stride_; } //elements per padded row
+            const T* operator[](size_t i) const { return begin() + i*stride_; }
+
+            // Modification
+            Aligned_matrix& operator=(const Aligned_matrix&);
+            T* operator[](size_t i) { return begin() + i*stride_; }
+            void swap(Aligned_matrix&);     //without copying the elements
+
+        private:
+            void init(size_t r, size_t c);
+            const T* begin() const { return &mem_[0] + offset_; }
+            T* begin() { return &mem_[0] + offset_; }
+            const T* end() const { return begin() + nrow_*stride_; }
+
+            size_t nrow_;
+            size_t ncol_;
+            size_t stride_;
+            size_t offset_;             //first element aligned to 64 bytes
+            std::vector<T> mem_;
+    };
+
+    // ========================================================================
+    // Aligned_matrix implementation
+    template<class T> inline void Aligned_matrix<T>::init(size_t r, size_t c)
+    {
+        // Element sizes not dividing 64 are only aligned to their own size
+        size_t line = 64 % sizeof(T) == 0 ? 64/sizeof(T) : 1;
+        nrow_ = r;
+        ncol_ = c;
+        stride_ = (c + line - 1)/line*line;
+        mem_.assign(nrow_*stride_ + line, T());
+        size_t gap = (64 - size_t(&mem_[0]) % 64) % 64;
+        offset_ = (line == 1 || gap % sizeof(T) != 0) ? 0 : gap/sizeof(T);
+    }
+
+    template<class T> inline Aligned_matrix<T>&
+        Aligned_matrix<T>::operator=(const Aligned_matrix& m)
+    {
+        if (this != &m) {
+            init(m.nrow_, m.ncol_);
+            std::copy(m.begin(), m.end(), begin());
+        }
+        return *this;
+    }
+
+    template<class T> inline void Aligned_matrix<T>::swap(Aligned_matrix& m)
+    {
+        // The offset stays valid as the memory of mem_ is swapped, not moved
+        std::swap(nrow_, m.nrow_);
+        std::swap(ncol_, m.ncol_);
+        std::swap(stride_, m.stride_);
+        std::swap(offset_, m.offset_);
+        mem_.swap(m.mem_);
+    }
+
+} // namespace detail
+} // namespace Permory
+
+#endif // include guard
@@ -0,0 +1,75 @@
+// Copyright (c) 2026 The Permory contributors
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt.)
+
+#ifndef permory_detail_bit_matrix_hpp
+#define permory_detail_bit_matrix_hpp
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/dynamic_bitset.hpp>
+
+#include "detail/aligned_matrix.hpp"
+#include "detail/popcount.hpp"
+
+namespace Permory { namespace detail {
+
+    //
+    // Matrix of bits stored row by row in one contiguous block of words. Each
+    // row starts at a 64 byte boundary and is padded with zero words up to
+    // the next one, as needed by the kernels in popcount.hpp.
+    //
+    class Bit_matrix {
+        public:
+            typedef boost::dynamic_bitset<> bitset_t;
+
+            // Ctor
+            Bit_matrix(size_t r=0, size_t c=0)
+                : ncol_(c), words_(r, (c + bits - 1)/bits) { }
+
+            // Inspection
+            bool empty() const { return words_.empty(); }
+            size_t nrow() const { return words_.nrow(); }
+            size_t ncol() const { return ncol_; }   //number of bits per row
+            size_t nwords() const { return words_.stride(); } //words per row
+            const word_t* operator[](size_t i) const { return words_[i]; }
+
+            // Modification
+            word_t* operator[](size_t i) { return words_[i]; }
+            void set_row(size_t i, const bitset_t&);
+            void swap(Bit_matrix& m) {
+                std::swap(ncol_, m.ncol_);
+                words_.swap(m.words_);
+            }
+
+            // Conversion
+            // Words of a bitset of ncol() bits padded like a row
+            void to_words(const bitset_t&, std::vector<word_t>&) const;
+
+        private:
+            static const size_t bits = 8*sizeof(word_t);
+            size_t ncol_;
+            Aligned_matrix<word_t> words_;
+    };
+
+    // ========================================================================
+    // Bit_matrix implementation
+    inline void Bit_matrix::set_row(size_t i, const bitset_t& b)
+    {
+        assert(i < nrow() && b.size() == ncol_);
+        boost::to_block_range(b, (*this)[i]);
+    }
+
+    inline void Bit_matrix::to_words(const bitset_t& b,
+            std::vector<word_t>& w) const
+    {
+        assert(b.size() == ncol_);
+        w.assign(nwords(), 0);
+        boost::to_block_range(b, w.begin());
+    }
+
+} // namespace detail
+} // namespace Permory
+
+#endif // include guard
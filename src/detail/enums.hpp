@@ -11,7 +11,7 @@ namespace Permory { namespace detail {
 
     // Supported data formats
     enum datafile_format{
-        unknown=0, compact, slide, presto, plink_tfam, plink_tped };
+        unknown=0, compact, slide, presto, plink_tfam, plink_tped, plink_bed };
 
     enum Marker_type {allelic, genotype};
 
@@ -65,6 +65,7 @@ namespace Permory { namespace detail {
         file_formats_.insert(dff_bimap::value_type(compact, "compact (*.comp)"));
         file_formats_.insert(dff_bimap::value_type(plink_tfam, "PLINK (*.tfam)"));
         file_formats_.insert(dff_bimap::value_type(plink_tped, "PLINK (*.tped)"));
+        file_formats_.insert(dff_bimap::value_type(plink_bed, "PLINK (*.bed)"));
         file_formats_.insert(dff_bimap::value_type(presto, "PRESTO (*.bgl)"));
         file_formats_.insert(dff_bimap::value_type(slide, "SLIDE (*.slide)"));
         file_formats_.insert(dff_bimap::value_type(unknown, "unknown"));
@@ -6,6 +6,7 @@
 #ifndef permory_detail_functors_hpp
 #define permory_detail_functors_hpp
 
+#include <algorithm>
 #include <functional>
 #include <deque>
 
@@ -38,6 +39,13 @@ namespace Permory { namespace detail {
     // Operators
     // =======================================================================
 
+    // Returns the larger of two values
+    template<class T> struct op_max : 
+        public std::binary_function<T, T, T>
+    {
+            T operator()(const T& x, const T& y) const { return std::max(x, y); }
+    };
+
     // Concatenates two sorted deques into one.
     template<class T> struct deque_concat :
         public std::binary_function< std::deque<T>, std::deque<T>, std::deque<T> >
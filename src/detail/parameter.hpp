@@ -6,6 +6,7 @@
 #ifndef permory_detail_parameter_hpp
 #define permory_detail_parameter_hpp
 
+#include <map>
 #include <set>
 #include <string>
 
@@ -49,6 +50,7 @@ namespace Permory { namespace detail {
             // Input
             //
             static std::set<std::string> fn_marker_data;//data file names
+            static std::map<std::string, datafile_format> marker_data_format;
             static std::string fn_trait;        //trait/phenotype file name
             //static std::string fn_meta;         //meta information file name
 
@@ -74,10 +76,27 @@ namespace Permory { namespace detail {
             int seed;                   //random seed;
             static size_t nperm_total;  //total number of permutations
             static size_t nperm_block;  //block-wise number of permutations
+            static bool usePhilox;      //counter-based random numbers yes/no
+            static double precision;    //stop when top p-values are resolved
+                                        //  to precision*alpha (0: never)
+            static bool gpdTail;        //extrapolate small p-values yes/no
+            static double checkpoint;   //minutes between checkpoints (0: none)
+            static bool resume;         //continue from checkpoint yes/no
 
             // speed optimization
             static size_t tail_size;    //size of tail (REM method)
             static bool useBar;         //use bit arithmetics yes/no
+            static bool useBsl;         //use bit-sliced counting yes/no
+            static size_t nthreads;     //number of threads
+            static bool splitPerm;      //threads split permutations yes/no
+            static bool inMemory;       //keep marker data in memory yes/no
+            static size_t prefetch;     //markers read ahead by a thread
+                                        //  of their own (0: none)
+            static bool compactPerm;    //bit-packed permutations only yes/no
+            static size_t mem_limit;    //memory budget in bytes (0: none)
+            static bool mpiDynamic;     //MPI processes pull blocks yes/no
+            static bool calibrate;      //time the permutation methods yes/no
+            static std::string fn_cost_model; //file of calibrated costs
 
     };
 
@@ -116,6 +135,7 @@ namespace Permory { namespace detail {
     // Input
     //
     std::set<std::string> Parameter::fn_marker_data; 
+    std::map<std::string, datafile_format> Parameter::marker_data_format;
     std::string Parameter::fn_trait = "";                
     //std::string Parameter::fn_meta = "";                
 
@@ -140,8 +160,23 @@ namespace Permory { namespace detail {
     //
     size_t Parameter::nperm_total = 10000;
     size_t Parameter::nperm_block = 10000;
+    bool Parameter::usePhilox = false;
+    double Parameter::precision = 0;
+    bool Parameter::gpdTail = false;
+    double Parameter::checkpoint = 0;
+    bool Parameter::resume = false;
     size_t Parameter::tail_size = 100;
     bool Parameter::useBar = true;
+    bool Parameter::useBsl = true;
+    size_t Parameter::nthreads = 1;
+    bool Parameter::splitPerm = false;
+    bool Parameter::inMemory = false;
+    size_t Parameter::prefetch = 64;
+    bool Parameter::compactPerm = false;
+    size_t Parameter::mem_limit = 0;
+    bool Parameter::mpiDynamic = false;
+    bool Parameter::calibrate = false;
+    std::string Parameter::fn_cost_model = "";
 
 } //namespace detail
 } //namespace Permory
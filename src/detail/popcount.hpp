@@ -0,0 +1,215 @@
+// Copyright (c) 2026 The Permory contributors
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt.)
+
+#ifndef permory_detail_popcount_hpp
+#define permory_detail_popcount_hpp
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/dynamic_bitset.hpp>
+
+// Runtime dispatch to SIMD kernels needs the target attribute of gcc/clang
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) \
+    && (__GNUC__ >= 5 || defined(__clang__))
+#   define PERMORY_X86_DISPATCH 1
+#   include <immintrin.h>
+#   if (defined(__clang__) && __clang_major__ >= 8) \
+        || (!defined(__clang__) && __GNUC__ >= 8)
+#       define PERMORY_X86_AVX512_POPCNT 1
+#   endif
+#endif
+
+namespace Permory { namespace detail {
+
+    //
+    // Kernels counting the bits of (a & b) for two arrays of n words, which
+    // is the core operation of the bit arithmetic (BAR) method. The size of
+    // the arrays in bytes must be a multiple of 64, i.e. the arrays must be
+    // padded with zero words. The fastest kernel supported by the CPU is
+    // chosen at runtime.
+    //
+    typedef boost::dynamic_bitset<>::block_type word_t;
+    typedef size_t (*and_count_fn)(const word_t*, const word_t*, size_t);
+
+    // Number of words in 64 bytes, the padding unit of the word arrays
+    const size_t words_per_line = 64/sizeof(word_t);
+
+    inline size_t popcount_word(word_t x)
+    {
+#if defined(__GNUC__)
+        return sizeof(word_t) == sizeof(unsigned long long) ?
+            __builtin_popcountll(x) : __builtin_popcountl(x);
+#else
+        size_t cnt = 0;
+        for (; x; ++cnt) {
+            x &= x - 1;
+        }
+        return cnt;
+#endif
+    }
+
+    // Position of the lowest set bit of x, which must not be zero
+    inline size_t lowest_bit(word_t x)
+    {
+#if defined(__GNUC__)
+        return sizeof(word_t) == sizeof(unsigned long long) ?
+            __builtin_ctzll(x) : __builtin_ctzl(x);
+#else
+        size_t i = 0;
+        for (; (x & 1) == 0; ++i) {
+            x >>= 1;
+        }
+        return i;
+#endif
+    }
+
+    inline size_t and_count_generic(const word_t* a, const word_t* b, size_t n)
+    {
+        size_t cnt = 0;
+        for (size_t i=0; i<n; ++i) {
+            cnt += popcount_word(a[i] & b[i]);
+        }
+        return cnt;
+    }
+
+#ifdef PERMORY_X86_DISPATCH
+    // Same as the generic kernel but compiled to use the popcnt instruction
+    __attribute__((target("popcnt"))) inline size_t and_count_popcnt(
+            const word_t* a, const word_t* b, size_t n)
+    {
+        size_t cnt = 0;
+        for (size_t i=0; i<n; ++i) {
+            cnt += __builtin_popcountll(a[i] & b[i]);
+        }
+        return cnt;
+    }
+
+    // Nibble lookup via byte shuffle (W. Mula), summed up with sad_epu8
+    __attribute__((target("avx2"))) inline size_t and_count_avx2(
+            const word_t* a, const word_t* b, size_t n)
+    {
+        const __m256i lookup = _mm256_setr_epi8(
+                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i low_mask = _mm256_set1_epi8(0x0f);
+        const __m256i* pa = reinterpret_cast<const __m256i*>(a);
+        const __m256i* pb = reinterpret_cast<const __m256i*>(b);
+        size_t nvec = n*sizeof(word_t)/32;
+        __m256i acc = _mm256_setzero_si256();
+        for (size_t i=0; i<nvec; ++i) {
+            __m256i x = _mm256_and_si256(
+                    _mm256_loadu_si256(pa + i), _mm256_loadu_si256(pb + i));
+            __m256i lo = _mm256_and_si256(x, low_mask);
+            __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask);
+            __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                    _mm256_shuffle_epi8(lookup, hi));
+            acc = _mm256_add_epi64(acc,
+                    _mm256_sad_epu8(cnt, _mm256_setzero_si256()));
+        }
+        long long sum[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(sum), acc);
+        return size_t(sum[0] + sum[1] + sum[2] + sum[3]);
+    }
+
+#ifdef PERMORY_X86_AVX512_POPCNT
+    __attribute__((target("avx512f,avx512vpopcntdq"))) inline size_t
+        and_count_avx512(const word_t* a, const word_t* b, size_t n)
+    {
+        size_t nvec = n*sizeof(word_t)/64;
+        __m512i acc = _mm512_setzero_si512();
+        for (size_t i=0; i<nvec; ++i) {
+            __m512i x = _mm512_and_si512(
+                    _mm512_loadu_si512(a + i*words_per_line),
+                    _mm512_loadu_si512(b + i*words_per_line));
+            acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(x));
+        }
+        long long sum[8];
+        _mm512_storeu_si512(sum, acc);
+        return size_t(sum[0] + sum[1] + sum[2] + sum[3]
+                + sum[4] + sum[5] + sum[6] + sum[7]);
+    }
+#endif // PERMORY_X86_AVX512_POPCNT
+#endif // PERMORY_X86_DISPATCH
+
+    //
+    // Kernels counting the bits of (a ^ b), i.e. the hamming distance, for
+    // two arrays of n words. Used to compare dummy codes, which are much
+    // shorter than a BAR row, so a scalar kernel is sufficient.
+    //
+    inline size_t xor_count_generic(const word_t* a, const word_t* b, size_t n)
+    {
+        size_t cnt = 0;
+        for (size_t i=0; i<n; ++i) {
+            cnt += popcount_word(a[i] ^ b[i]);
+        }
+        return cnt;
+    }
+
+#ifdef PERMORY_X86_DISPATCH
+    __attribute__((target("popcnt"))) inline size_t xor_count_popcnt(
+            const word_t* a, const word_t* b, size_t n)
+    {
+        size_t cnt = 0;
+        for (size_t i=0; i<n; ++i) {
+            cnt += __builtin_popcountll(a[i] ^ b[i]);
+        }
+        return cnt;
+    }
+#endif
+
+    inline and_count_fn fastest_xor_count_kernel()
+    {
+#ifdef PERMORY_X86_DISPATCH
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("popcnt")) {
+            return &xor_count_popcnt;
+        }
+#endif
+        return &xor_count_generic;
+    }
+
+    // The xor kernel to use, determined once
+    inline and_count_fn xor_count_kernel()
+    {
+        static const and_count_fn k = fastest_xor_count_kernel();
+        return k;
+    }
+
+    // All kernels the CPU supports, fastest first
+    inline std::vector<std::pair<std::string, and_count_fn> >
+        available_and_count_kernels()
+    {
+        std::vector<std::pair<std::string, and_count_fn> > v;
+#ifdef PERMORY_X86_DISPATCH
+        __builtin_cpu_init();
+#ifdef PERMORY_X86_AVX512_POPCNT
+        if (__builtin_cpu_supports("avx512vpopcntdq")) {
+            v.push_back(std::make_pair("avx512", &and_count_avx512));
+        }
+#endif
+        if (__builtin_cpu_supports("avx2")) {
+            v.push_back(std::make_pair("avx2", &and_count_avx2));
+        }
+        if (__builtin_cpu_supports("popcnt")) {
+            v.push_back(std::make_pair("popcnt", &and_count_popcnt));
+        }
+#endif
+        v.push_back(std::make_pair("generic", &and_count_generic));
+        return v;
+    }
+
+    // The kernel to use, determined once
+    inline const std::pair<std::string, and_count_fn>& and_count_kernel()
+    {
+        static const std::pair<std::string, and_count_fn> k =
+            available_and_count_kernels().front();
+        return k;
+    }
+
+} // namespace detail
+} // namespace Permory
+
+#endif // include guard
@@ -0,0 +1,130 @@
+// Copyright (c) 2026 The Permory contributors
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt.)
+
+#ifndef permory_detail_thread_team_hpp
+#define permory_detail_thread_team_hpp
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/barrier.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "detail/config.hpp"
+
+namespace Permory { namespace detail {
+
+    //
+    // A fixed team of n threads (the calling thread being member 0) that
+    // repeatedly executes the same kind of job. Each call of run(f) lets
+    // every member i call f(i) and returns after all members are done, so
+    // the threads are created only once per analysis instead of once per
+    // job. An exception thrown by any member is rethrown in the caller.
+    //
+    class Thread_team : boost::noncopyable {
+        public:
+            typedef boost::function<void (size_t)> job_t;
+
+            // Ctor + Dtor
+            explicit Thread_team(size_t n=1);
+            ~Thread_team();
+
+            // Inspection
+            size_t size() const { return n_; }
+
+            // Modification
+            void run(const job_t&);
+
+        private:
+            void work(size_t);          //loop of each helper thread
+            void call(size_t);          //run job and catch exceptions
+
+            size_t n_;
+            job_t job_;
+            bool stop_;
+            std::string error_;         //what() of first exception caught
+            bool hasError_;
+            boost::mutex mutex_;
+            boost::barrier start_;
+            boost::barrier done_;
+            boost::thread_group helpers_;
+    };
+
+    // ========================================================================
+    // Thread_team implementation
+    inline Thread_team::Thread_team(size_t n)
+        : n_(std::max(n, size_t(1))), stop_(false), hasError_(false),
+        start_(n_), done_(n_)
+    {
+        for (size_t i=1; i<n_; ++i) {
+            helpers_.create_thread(boost::bind(&Thread_team::work, this, i));
+        }
+    }
+
+    inline Thread_team::~Thread_team()
+    {
+        if (n_ > 1) {
+            stop_ = true;
+            start_.wait();      //wake up helpers, which then return
+            helpers_.join_all();
+        }
+    }
+
+    inline void Thread_team::run(const job_t& f)
+    {
+        if (n_ == 1) {          //nothing to synchronize
+            f(0);
+            return;
+        }
+        job_ = f;
+        hasError_ = false;
+        start_.wait();
+        call(0);
+        done_.wait();
+        if (hasError_) {
+            throw std::runtime_error(error_);
+        }
+    }
+
+    inline void Thread_team::work(size_t i)
+    {
+        while (true) {
+            start_.wait();
+            if (stop_) {
+                return;
+            }
+            call(i);
+            done_.wait();
+        }
+    }
+
+    inline void Thread_team::call(size_t i)
+    {
+        try {
+            job_(i);
+        }
+        catch (const std::exception& e) {
+            boost::mutex::scoped_lock lock(mutex_);
+            if (not hasError_) {
+                error_ = e.what();
+                hasError_ = true;
+            }
+        }
+        catch (...) {
+            boost::mutex::scoped_lock lock(mutex_);
+            if (not hasError_) {
+                error_ = "Unknown exception in thread.";
+                hasError_ = true;
+            }
+        }
+    }
+
+} // namespace detail
+} // namespace Permory
+
+#endif // include guard
@@ -34,6 +34,8 @@ namespace Permory
             // Ctor
             explicit Discrete_data(const std::vector<T>&);  
             explicit Discrete_data(const_iterator, const_iterator);
+            // Data whose unique elements with counts are known already
+            Discrete_data(const std::vector<T>&, const std::map<T, count_t>&);
 
             // Inspection
             const T& operator[](const size_t pos) const { return data_[pos]; }
@@ -71,10 +73,18 @@ namespace Permory
     {
         init();
     }
+    template<class T> inline Discrete_data<T>::Discrete_data(
+            const std::vector<T>& d, const std::map<T, count_t>& unique)
+        : data_(d), unique_(unique)
+    {
+        init();
+    }
     template<class T> inline void Discrete_data<T>::init() 
     {
-        BOOST_FOREACH(T i, this->data_) {
-            unique_[i]++;
+        if (unique_.empty()) {  //else given on construction
+            BOOST_FOREACH(T i, this->data_) {
+                unique_[i]++;
+            }
         }
         for (typename std::map<T, uint>::iterator i=unique_.begin(); 
                 i!=unique_.end(); i++)
@@ -6,28 +6,45 @@
 #ifndef permory_analysis_hpp
 #define permory_analysis_hpp
 
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <memory>
 #include <set>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <iomanip>
 
+#include <boost/bind.hpp>
 #include <boost/progress.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/type_traits/is_integral.hpp>
 
 #include "detail/config.hpp"
 #include "detail/parameter.hpp"
 #include "detail/exception.hpp"
+#include "detail/functors.hpp"
+#include "detail/thread_team.hpp"
+#include "checkpoint.hpp"
 #include "gwas.hpp"
 #include "locusdata.hpp"
 #include "locus_filter.hpp"
+#include "marker_source.hpp"
+#include "packed_locus_store.hpp"
 #include "io/output.hpp"
+#include "permutation/cost_model.hpp"
 #include "permutation/permutation.hpp"
 #include "read_phenotype_data.hpp"
 #include "read_locus_data.hpp"
 #include "result_output.hpp"
 #include "statistical/dichotom.hpp"
+#include "statistical/exceedance.hpp"
+#include "statistical/gpd.hpp"
 #include "statistical/quantitative.hpp"
 #include "statistical/pvalue.hpp"
 
@@ -39,7 +56,8 @@ namespace Permory { namespace gwas {
             Analyzer(
                     detail::Parameter* par, io::Myout& out,
                     Gwas* study, std::set<char> the_domain=std::set<char>())
-                : par_(par), out_(out), study_(study), domain_(the_domain)
+                : par_(par), out_(out), study_(study), domain_(the_domain),
+                firstPerm_(0)
                 { init_filters(); }
 
             // Dtor
@@ -49,19 +67,137 @@ namespace Permory { namespace gwas {
             template<class S, class T> void analyze();
 
         protected:
-            virtual void output_results(const std::deque<double>& tperm);
+            virtual void output_results(const statistic::Exceedance_counts&);
             virtual void init_filters(); // Define locus filter (e.g. maf filter)
+            virtual Marker_source* marker_source();
+            virtual size_t prefetch() const;  //markers read ahead of analysis
+            virtual size_t next_block(size_t perm_todo,
+                    permutation::Permutation&);
+            virtual void poll() { }     //called between markers
+            virtual std::string checkpoint_file() const;
             detail::Parameter* par_;
             io::Myout& out_;
             Gwas* study_;
             std::set<char> domain_;
+            size_t firstPerm_;  //number of first permutation (counter-based)
 
             boost::ptr_vector<Locus_filter> locus_filters_;
 
         private:
             bool check_locus(Gwas::iterator, const Locus_data<char>&);
             void check_locus_data(Gwas::iterator, Locus_data<char>&, size_t);
+            void check_next_locus_data(Gwas::iterator*, size_t,
+                    Locus_data<char>&);
             std::vector<Individual> make_trait() const;
+            Checkpoint checkpoint_of_run() const;
+            bool load_checkpoint(Checkpoint&);
+            std::deque<double> test_statistics() const;
+            std::deque<double> top_statistics() const;
+            size_t ntail() const;
+            bool isResolved(const std::deque<double>& top,
+                    const statistic::Exceedance_counts&) const;
+            size_t batch_size(size_t nsubject) const;
+            template<class S> void permute_batch(
+                    detail::Thread_team&,
+                    const std::vector<S*>& workers,
+                    boost::ptr_vector<Locus_data<char> >& batch,
+                    size_t nactive);
+            template<class S> size_t split_permutations(
+                    detail::Thread_team&,
+                    const std::vector<S*>& workers,
+                    const permutation::Permutation& pp,
+                    size_t nperm);
+            template<class S> size_t rem_tail_size() const;
+            template<class S> void set_cost_model(const std::vector<S*>& workers);
+            template<class S> void fit_block_size(size_t nsubject);
+    };
+
+    //
+    // Job for a team of threads: each thread runs the permutation test for
+    // its own contiguous share of a batch of markers using its own statistic
+    // object. Keeping the shares contiguous preserves the locality of
+    // neighbouring markers the REM method depends on.
+    template<class S> class Marker_split_job {
+        public:
+            Marker_split_job(
+                    const std::vector<S*>& workers,
+                    const boost::ptr_vector<Locus_data<char> >& batch)
+                : workers_(workers), batch_(batch)
+            {}
+            void operator()(size_t i) const {
+                size_t n = workers_.size();
+                size_t share = (batch_.size() + n - 1)/n;
+                size_t first = std::min(i*share, batch_.size());
+                size_t last = std::min(first + share, batch_.size());
+                for (size_t k=first; k<last; ++k) {
+                    workers_[i]->permutation_test(batch_[k]);
+                }
+            }
+        private:
+            const std::vector<S*>& workers_;
+            const boost::ptr_vector<Locus_data<char> >& batch_;
+    };
+
+    //
+    // Job for a team of threads: each thread runs the permutation test for
+    // all markers of a batch but only for its own slice of the permutations,
+    // so that the threads own disjoint parts of the max test statistics and
+    // the results need not be merged. Only the first nactive threads have
+    // permutations, which matters if there are fewer permutations than threads.
+    template<class S> class Perm_split_job {
+        public:
+            Perm_split_job(
+                    const std::vector<S*>& workers,
+                    const boost::ptr_vector<Locus_data<char> >& batch,
+                    size_t nactive)
+                : workers_(workers), batch_(batch), nactive_(nactive)
+            {}
+            void operator()(size_t i) const {
+                if (i >= nactive_) {
+                    return;
+                }
+                for (size_t k=0; k<batch_.size(); ++k) {
+                    workers_[i]->permutation_test(batch_[k]);
+                }
+            }
+        private:
+            const std::vector<S*>& workers_;
+            const boost::ptr_vector<Locus_data<char> >& batch_;
+            size_t nactive_;
+    };
+
+    //
+    // Job for a team of threads: with a counter-based generator, the slices
+    // of permutations do not depend on each other, so each thread creates
+    // the slice of its own statistic object. Slice i starts with
+    // permutation number first + i*(nperm/nactive) + min(i, nperm%nactive).
+    template<class S> class Perm_build_job {
+        public:
+            Perm_build_job(
+                    const std::vector<S*>& workers,
+                    size_t nactive, size_t first, size_t nperm,
+                    size_t seed, size_t tail_size)
+                : workers_(workers), nactive_(nactive), first_(first),
+                nperm_(nperm), seed_(seed), tail_size_(tail_size)
+            {}
+            void operator()(size_t i) const {
+                if (i >= nactive_) {
+                    return;
+                }
+                size_t share = nperm_/nactive_;
+                size_t rest = nperm_%nactive_;
+                permutation::Permutation pp(seed_, true);
+                pp.set_next_index(first_ + i*share + std::min(i, rest));
+                workers_[i]->renew_permutations(&pp, share + (i < rest),
+                        tail_size_);
+            }
+        private:
+            const std::vector<S*>& workers_;
+            size_t nactive_;
+            size_t first_;
+            size_t nperm_;
+            size_t seed_;
+            size_t tail_size_;
     };
 
     // Factories
@@ -112,8 +248,21 @@ namespace Permory { namespace gwas {
         using namespace io;
         using namespace Permory::detail;
 
-        // Prepare progress bar
+        vector<Individual> trait(this->make_trait());
+        if (par_->mem_limit > 0) {
+            this->fit_block_size<S>(trait.size());
+        }
+
+        // Continue where a previous run stopped (--resume)
         size_t perm_todo = par_->nperm_total;        //remaining permutations
+        Checkpoint saved;
+        bool isResumed = par_->resume && this->load_checkpoint(saved);
+        if (isResumed) {
+            perm_todo = saved.perm_todo;
+        }
+        std::time_t last_checkpoint = std::time(0);
+
+        // Prepare progress bar
         scoped_ptr<progress_display> pprogress;
         bool show_progress = not par_->quiet;
         if (show_progress) {
@@ -122,57 +271,192 @@ namespace Permory { namespace gwas {
                         std::cout, "","",""));
         }
 
-        vector<Individual> trait(this->make_trait());
         S stat(*par_, trait.begin(), trait.end());   //computes all statistic stuff
-        permutation::Permutation pp(par_->seed);     //does the shuffling/permutation
+        permutation::Permutation pp(par_->seed, par_->usePhilox); //does the shuffling/permutation
+        pp.set_next_index(firstPerm_);
+        if (isResumed) {
+            pp.set_state(saved.rng);
+        }
         Gwas::iterator itLocus = study_->begin();    //points to current locus
 
+        // Each additional thread gets its own statistic object, that is, its
+        // own boosters and results, while the permutations are shared
+        Thread_team team(par_->nthreads);
+        boost::ptr_vector<S> helpers;
+        vector<S*> workers(1, &stat);
+        for (size_t i=1; i<team.size(); ++i) {
+            helpers.push_back(new S(*par_, trait.begin(), trait.end()));
+            workers.push_back(&helpers.back());
+        }
+        size_t tail_size = this->rem_tail_size<S>();
+        boost::ptr_vector<Locus_data<char> > batch; //markers to be permuted
+        size_t batch_sz = this->batch_size(trait.size());
+        Packed_locus_store store;   //markers kept in memory (if requested)
+
         bool isFirstRound = true;
-        deque<double> tperm;    //holds the maximum test statistic per permutation
+        statistic::Exceedance_counts exceed; //counts of the max test statistics
+        deque<double> top;      //test statistics of the top markers
         while (perm_todo > 0) {
             // By default analysis is done in blocks of 10000 permutations. In
             // each block each marker is analyzed one by one
-            size_t nperm = par_->nperm_block;
-            if (nperm > perm_todo) {
-                nperm = perm_todo;
+            size_t nperm = this->next_block(perm_todo, pp);
+            if (nperm == 0) {
+                break;
+            }
+            for (size_t i=0; i<workers.size(); ++i) {
+                workers[i]->release_permutations();
+            }
+            size_t nactive = workers.size(); //threads having permutations
+            if (par_->splitPerm) {
+                nactive = this->split_permutations(team, workers, pp, nperm);
+            }
+            else {
+                stat.renew_permutations(&pp, nperm, tail_size); //fresh random numbers
+                for (size_t i=1; i<workers.size(); ++i) {
+                    workers[i]->use_permutations(stat.permutation_matrix(),
+                            tail_size);
+                }
+            }
+            if (isFirstRound) {
+                this->set_cost_model(workers);
             }
-            stat.renew_permutations(&pp, nperm, par_->tail_size); //fresh random numbers
-            itLocus = study_->begin();
 
-            BOOST_FOREACH(string fn, par_->fn_marker_data) {
-                Locus_data_reader<char> loc_reader(fn, par_->undef_allele_code);
+            // In memory mode the markers read in the first round are kept, so
+            // later rounds neither read nor parse any files
+            bool isFromMemory = par_->inMemory && not isFirstRound;
+            if (isFromMemory) {
+                vector<char> scratch;   //decoded data of a marker
+                for (size_t i=0; i<store.size(); ++i) {
+                    batch.push_back(store.get(i, scratch));
+                    if (batch.size() == batch_sz) {
+                        this->permute_batch(team, workers, batch, nactive);
+                    }
+                    this->poll();
+                    if (show_progress) {
+                        ++(*pprogress);
+                    }
+                }
+                if (show_progress) {   //account for skipped markers
+                    (*pprogress) += study_->m() - store.size();
+                }
+            }
+            else {
+                // The markers are read, parsed and checked ahead by a
+                // thread of their own while the ones before are analyzed
+                itLocus = study_->begin();
+                Gwas::iterator itChecked = study_->begin();
+                Prefetching_marker_source source(this->marker_source(),
+                        this->prefetch(),
+                        boost::bind(&Analyzer::check_next_locus_data, this,
+                            &itChecked, trait.size(), _1));
 
-                while (loc_reader.hasData()) {
-                    std::vector<char> v;
-                    loc_reader.get_next(v);
-                    Locus_data<char> locdat(v, par_->undef_allele_code);
-                    this->check_locus_data(itLocus, locdat, trait.size());
+                while (true) {
+                    std::auto_ptr<Locus_data<char> > locdat(source.next());
+                    if (not locdat.get()) {
+                        break;
+                    }
 
                     // The non-permutation stuff needs only to be done once
                     if (isFirstRound) {
-                        bool ok = this->check_locus(itLocus, locdat);
+                        bool ok = this->check_locus(itLocus, *locdat);
                         if (ok) {
-                            itLocus->add_test_stats(stat.test(locdat));
+                            itLocus->add_test_stats(stat.test(*locdat));
                         }
                     }
 
                     if (itLocus->hasTeststat()) {
-                        stat.permutation_test(locdat);
+                        if (par_->inMemory) {
+                            store.add(*locdat);
+                        }
+                        batch.push_back(locdat.release());
                     }
+                    if (batch.size() == batch_sz) {
+                        this->permute_batch(team, workers, batch, nactive);
+                    }
+                    this->poll();
                     if (show_progress) {
                         ++(*pprogress);
                     }
                     itLocus++;
                 }
             }
+            this->permute_batch(team, workers, batch, nactive);
             perm_todo -= nperm;
-            copy(stat.tmax_begin(), stat.tmax_end(), back_inserter(tperm));
+
+            vector<double> tmax;    //max test statistic per permutation
+            if (par_->splitPerm) {
+                // Each thread owns a slice of the permutations, which are
+                // simply put together in order
+                for (size_t i=0; i<nactive; ++i) {
+                    copy(workers[i]->tmax_begin(), workers[i]->tmax_end(),
+                            back_inserter(tmax));
+                }
+            }
+            else {
+                // Combine the results of all threads by taking the maximum
+                tmax.assign(stat.tmax_begin(), stat.tmax_end());
+                for (size_t i=1; i<workers.size(); ++i) {
+                    transform(tmax.begin(), tmax.end(), workers[i]->tmax_begin(),
+                            tmax.begin(), op_max<double>());
+                }
+            }
+
+            // The test statistics are known after the first round, so the
+            // exceedances can be counted block by block
+            if (isFirstRound) {
+                exceed = statistic::Exceedance_counts(this->test_statistics(),
+                        this->ntail());
+                if (isResumed) {
+                    try {
+                        exceed.merge(saved.exceed);
+                    }
+                    catch (const invalid_argument&) {
+                        throw runtime_error("Checkpoint `" + checkpoint_file()
+                                + "' does not match the marker data.");
+                    }
+                }
+            }
+            exceed.add(tmax);
+
+            // Stop early once the p-values of the top markers are resolved
+            if (par_->precision > 0 && perm_todo > 0) {
+                if (isFirstRound) {
+                    top = this->top_statistics();
+                }
+                if (this->isResolved(top, exceed)) {
+                    if (show_progress) {
+                        std::cout << std::endl;
+                    }
+                    out_ << normal << stdpre << "Top p-values resolved after "
+                        << exceed.nperm() << " permutations." << endl;
+                    perm_todo = 0;
+                    par_->nperm_total = exceed.nperm();
+                }
+            }
             isFirstRound = false;
+
+            // Save the state now and then, but not after the last block: a
+            // resumed run needs a block to compute the test statistics
+            double elapsed = difftime(std::time(0), last_checkpoint);
+            if (par_->checkpoint > 0 && perm_todo > 0
+                    && elapsed >= 60*par_->checkpoint) {
+                Checkpoint c = this->checkpoint_of_run();
+                c.perm_todo = perm_todo;
+                c.rng = pp.state();
+                c.exceed = exceed;
+                write_checkpoint(c, this->checkpoint_file());
+                last_checkpoint = std::time(0);
+            }
         }
 
-        sort(tperm.begin(), tperm.end());
-        study_ -> set_meff(tperm, par_->alpha); //effective number of independent tests
-        output_results(tperm);
+        //effective number of independent tests
+        study_ -> set_meff(exceed.quantile(1.0 - par_->alpha), par_->alpha);
+        output_results(exceed);
+
+        // The run is complete, so its checkpoint is of no use anymore
+        if (par_->checkpoint > 0 || isResumed) {
+            std::remove(this->checkpoint_file().c_str());
+        }
     }
 
     bool Analyzer::check_locus(Gwas::iterator itLocus,
@@ -225,6 +509,265 @@ namespace Permory { namespace gwas {
         }
     }
 
+    //
+    // Check the marker the iterator points to and advance it (the thread
+    // reading ahead keeps its own one)
+    void Analyzer::check_next_locus_data(Gwas::iterator* itLocus,
+            size_t trait_size, Locus_data<char>& locdat)
+    {
+        this->check_locus_data((*itLocus)++, locdat, trait_size);
+    }
+
+    //
+    //  Number of markers collected before they are permuted by the threads. A
+    //  single thread works on each marker right away. Otherwise each thread
+    //  gets up to 64 markers per batch as long as the batch does not occupy
+    //  more than 64 MB of genotype data.
+    size_t Analyzer::batch_size(size_t nsubject) const
+    {
+        size_t nthreads = std::max(par_->nthreads, size_t(1));
+        if (nthreads == 1) {
+            return 1;
+        }
+        size_t per_thread = (size_t(1) << 26)/(nthreads*std::max(nsubject, size_t(1)));
+        per_thread = std::max(size_t(1), std::min(per_thread, size_t(64)));
+        return nthreads*per_thread;
+    }
+
+    //
+    // Let the team of threads run the permutation test on the batch of
+    // markers and clear it afterwards
+    template<class S> void Analyzer::permute_batch(
+            detail::Thread_team& team,
+            const std::vector<S*>& workers,
+            boost::ptr_vector<Locus_data<char> >& batch,
+            size_t nactive)
+    {
+        if (par_->splitPerm) {
+            team.run(Perm_split_job<S>(workers, batch, nactive));
+        }
+        else {
+            team.run(Marker_split_job<S>(workers, batch));
+        }
+        batch.clear();
+    }
+
+    //
+    // Give each worker its own consecutive slice of fresh permutations. The
+    // slices continue each other, so the permutations are the same as the
+    // ones of a single worker. Returns the number of workers that got a
+    // non-empty slice.
+    template<class S> size_t Analyzer::split_permutations(
+            detail::Thread_team& team,
+            const std::vector<S*>& workers,
+            const permutation::Permutation& pp,
+            size_t nperm)
+    {
+        typedef typename S::perm_matrix_t perm_matrix_t;
+        size_t nactive = std::min(workers.size(), nperm);
+        if (pp.isCounterBased()) {  //slices can be created in parallel
+            size_t first = pp.draw(nperm);
+            team.run(Perm_build_job<S>(workers, nactive, first, nperm,
+                        pp.get_seed(), par_->tail_size));
+            return nactive;
+        }
+        size_t share = nperm/nactive;
+        size_t rest = nperm%nactive;
+        workers[0]->renew_permutations(&pp, share + (rest > 0),
+                par_->tail_size);
+        for (size_t i=1; i<nactive; ++i) {
+            boost::shared_ptr<perm_matrix_t> pmat(new perm_matrix_t(
+                        share + (i < rest), pp,
+                        *workers[i-1]->permutation_matrix()));
+            workers[i]->use_permutations(pmat, par_->tail_size);
+        }
+        return nactive;
+    }
+
+    //
+    // Size of the tail of the permutation boosters (REM method). If the
+    // threads share the markers, each one memoizes other markers than a
+    // single thread would, which changes the rounding of non-integral sums
+    // (quantitative traits). REM is not used then, so that the results do
+    // not depend on the number of threads.
+    template<class S> size_t Analyzer::rem_tail_size() const
+    {
+        bool isSharedMarkers = par_->nthreads > 1 && not par_->splitPerm;
+        if (isSharedMarkers 
+                && not boost::is_integral<typename S::count_t>::value) {
+            return 0;
+        }
+        return par_->tail_size;
+    }
+
+    //
+    // Costs deciding which permutation method is used per marker: timed on
+    // the first permutations (--calibrate), read from file (--cost-model) or
+    // the default ones.
+    template<class S> void Analyzer::set_cost_model(
+            const std::vector<S*>& workers)
+    {
+        using namespace std;
+        using namespace io;
+        using namespace Permory::detail;
+        permutation::Cost_model costs;
+        string fn = par_->fn_cost_model;
+        if (par_->calibrate) {
+            out_ << normal << stdpre << "Calibrating permutation methods..." << endl;
+            costs = permutation::calibrate(*workers[0]->permutation_matrix());
+            if (not fn.empty()) {
+                ofstream ofs(fn.c_str());
+                if (!ofs) {
+                    throw File_exception("Unable to write cost model file: " + fn);
+                }
+                costs.write(ofs);
+            }
+        }
+        else if (not fn.empty()) {
+            ifstream ifs(fn.c_str());
+            if (!ifs) {
+                throw File_exception("Unable to open cost model file: " + fn);
+            }
+            costs.read(ifs);
+        }
+        else {
+            return;
+        }
+        out_ << verbose << indent(4) << "cost of BAR per subject: " << costs.bar
+            << ", BSL: " << costs.bsl_fixed << " + " << costs.bsl_per_index
+            << " per index, REM: " << costs.rem_fixed << " + hamming distance"
+            << endl;
+        for (size_t i=0; i<workers.size(); ++i) {
+            workers[i]->set_cost_model(costs);
+        }
+    }
+
+    //
+    // Set the block size to the largest number of permutations, for which
+    // the permutation data (see statistic::Memory_use) and the structures
+    // not depending on the block size fit into the memory limit
+    template<class S> void Analyzer::fit_block_size(size_t nsubject)
+    {
+        using namespace std;
+        using namespace io;
+        using namespace Permory::detail;
+        const double mb = double(size_t(1) << 20);
+        statistic::Memory_use per = S::memory_use(*par_, nsubject);
+
+        // With split permutations the slices of all threads add up to one
+        // block, else each thread has its boosters and tables for all of it
+        size_t ncopy = par_->splitPerm ? 1 : max(par_->nthreads, size_t(1));
+        size_t per_perm = per.matrix + ncopy*(per.boosters + per.tables);
+
+        size_t fixed = statistic::Exceedance_counts::memory_use(
+                study_->m(), this->ntail())                 //exceedances
+            + batch_size(nsubject)*nsubject;                //batch of markers
+        if (par_->inMemory) {
+            fixed += study_->m()*((nsubject + 3)/4);        //2 bits per value
+        }
+        size_t limit = par_->mem_limit;
+        if (limit < fixed + per_perm) {
+            ostringstream oss;
+            oss << "--mem-limit " << limit/mb << " MB is too small, need at "
+                << "least " << (fixed + per_perm)/mb << " MB.";
+            throw runtime_error(oss.str());
+        }
+        size_t nperm = min((limit - fixed)/per_perm, par_->nperm_block);
+        nperm = min(nperm, par_->nperm_total);
+        par_->nperm_block = nperm;
+
+        out_ << normal << stdpre << "Memory per permutation of a block:" << endl;
+        out_ << normal << indent(4) << "permutations: " << per.matrix
+            << " bytes" << endl;
+        out_ << normal << indent(4) << "boosters: " << per.boosters
+            << " bytes (x" << ncopy << ")" << endl;
+        out_ << normal << indent(4) << "tables: " << per.tables
+            << " bytes (x" << ncopy << ")" << endl;
+        out_ << normal << indent(4) << "independent of block size: "
+            << fixed/mb << " MB" << endl;
+        out_ << normal << stdpre << "Block size: " << nperm << " permutations ("
+            << (fixed + nperm*per_perm)/mb << " of " << limit/mb << " MB)"
+            << endl;
+    }
+
+    //
+    // The test statistics (max over tests) of all markers
+    std::deque<double> Analyzer::test_statistics() const
+    {
+        std::deque<double> t(study_->m());
+        std::transform(study_->begin(), study_->end(), t.begin(),
+                std::mem_fun_ref(&Locus::tmax));
+        return t;
+    }
+
+    //
+    // The ntop largest test statistics of all markers, in decreasing order
+    std::deque<double> Analyzer::top_statistics() const
+    {
+        std::vector<double> t(study_->m());
+        std::transform(study_->begin(), study_->end(), t.begin(),
+                std::mem_fun_ref(&Locus::tmax));
+        size_t ntop = std::min(par_->ntop, t.size());
+        std::partial_sort(t.begin(), t.begin() + ntop, t.end(),
+                std::greater<double>());
+        return std::deque<double>(t.begin(), t.begin() + ntop);
+    }
+
+    //
+    // Number of largest max test statistics kept exactly (effective number
+    // of tests, --gpd)
+    size_t Analyzer::ntail() const
+    {
+        return statistic::exceedance_tail_size(par_->alpha, par_->nperm_total);
+    }
+
+    //
+    // Whether the top markers' p-values are resolved (see pvalues_resolved)
+    // with the permutations so far
+    bool Analyzer::isResolved(const std::deque<double>& top,
+            const statistic::Exceedance_counts& exceed) const
+    {
+        return statistic::pvalues_resolved(exceed.counts(top), exceed.nperm(),
+                par_->alpha, par_->precision);
+    }
+
+    //
+    // The parameters of this run, to which a checkpoint must belong
+    Checkpoint Analyzer::checkpoint_of_run() const
+    {
+        Checkpoint c;
+        c.nperm_total = par_->nperm_total;
+        c.nperm_block = par_->nperm_block;
+        c.seed = par_->seed;
+        c.usePhilox = par_->usePhilox;
+        c.first_perm = firstPerm_;
+        c.m = study_->m();
+        return c;
+    }
+
+    //
+    // Read the checkpoint of a previous run, if there is one
+    bool Analyzer::load_checkpoint(Checkpoint& c)
+    {
+        using namespace std;
+        using namespace io;
+        using namespace Permory::detail;
+        string fn = this->checkpoint_file();
+        if (not read_checkpoint(fn, c)) {
+            out_ << warnpre << "Warning: no checkpoint `" << fn
+                << "' found, starting from the first permutation." << endl;
+            return false;
+        }
+        if (not c.isSameRun(this->checkpoint_of_run())) {
+            throw runtime_error("Checkpoint `" + fn + "' is of a run with "
+                    "different parameters.");
+        }
+        out_ << normal << stdpre << "Resuming from checkpoint `" << fn << "': "
+            << c.exceed.nperm() << " of " << par_->nperm_total
+            << " permutations done." << endl;
+        return true;
+    }
+
     std::vector<Individual> Analyzer::make_trait() const
     {
         using namespace boost;
@@ -247,7 +790,7 @@ namespace Permory { namespace gwas {
     //
     //  Compute adjusted p-values and output results
     void Analyzer::output_results(
-            const std::deque<double>& tperm //*sorted* max test statistic per permutation
+            const statistic::Exceedance_counts& exceed //of all permutations
             )
     {
         using namespace std;
@@ -262,18 +805,36 @@ namespace Permory { namespace gwas {
 
         // Get tmax of original data and use permutation tmax to derive p-values
         out_ << normal << stdpre << "Creating result files." << endl;
-        deque<double> t_orig(study_->m());
-
         TIME("Runtime transform all: ",
-                transform(study_->begin(), study_->end(),
-                    t_orig.begin(), mem_fun_ref(&Locus::tmax)));
+                deque<double> t_orig = this->test_statistics());
+
+        TIME("Runtime exceedance counts all: ",
+                deque<size_t> counts = exceed.counts(t_orig));
 
-        TIME("Runtime single_step_counts all: ",
-                deque<size_t> counts = single_step_counts(t_orig, tperm));
+        // Tail of the permutation distribution for the smallest p-values
+        boost::scoped_ptr<Gpd_tail> tail;
+        if (par_->gpdTail) {
+            TIME("Runtime GPD tail fit: ",
+                    tail.reset(new Gpd_tail(exceed.largest(), exceed.nperm(),
+                            par_->seed)));
+            if (tail->isFitted()) {
+                out_ << verbose << stdpre << "GPD tail fit to the "
+                    << tail->nexceed() << " largest of " << exceed.nperm()
+                    << " max statistics: threshold = " << tail->threshold()
+                    << ", shape = " << tail->shape() << ", scale = "
+                    << tail->scale() << ", goodness of fit p = "
+                    << tail->gof_pvalue() << endl;
+            }
+            else {
+                out_ << warnpre << "Warning: no generalized Pareto "
+                    "distribution fits the tail of the permutations, P_gpd "
+                    "is not available." << endl;
+            }
+        }
         std::string fn = par_->out_prefix;
         fn.append(".all");
         TIME("Runtime result_to_file all: ",
-                result_to_file(par_, *study_, counts, fn));
+                result_to_file(par_, *study_, counts, fn, tail.get()));
 
         // The same but this time just for the top p-values
         TIME("Runtime sort top: ",
@@ -282,12 +843,46 @@ namespace Permory { namespace gwas {
         TIME("Runtime transform top: ",
                 transform(study_->begin(), study_->begin()+par_->ntop,
                     t_orig.begin(), mem_fun_ref(&Locus::tmax)));
-        TIME("Runtime single_step_counts top: ",
-                counts = single_step_counts(t_orig, tperm));
+        TIME("Runtime exceedance counts top: ",
+                counts = exceed.counts(t_orig));
         fn = par_->out_prefix;
         fn.append(".top");
         TIME("Runtime result_to_file top: ",
-                result_to_file(par_, *study_, counts, fn));
+                result_to_file(par_, *study_, counts, fn, tail.get()));
+    }
+
+    //
+    // Number of permutations of the next block, given perm_todo are left,
+    // or 0 if there are none. Counter-based permutations may be positioned
+    // at the first permutation of the block. By default the blocks simply
+    // continue each other.
+    size_t Analyzer::next_block(size_t perm_todo, permutation::Permutation&)
+    {
+        return std::min(par_->nperm_block, perm_todo);
+    }
+
+    //
+    // File of the state of this run (--checkpoint, --resume)
+    std::string Analyzer::checkpoint_file() const
+    {
+        return par_->out_prefix + ".checkpoint";
+    }
+
+    //
+    // Where the marker data of a round come from: the files
+    Marker_source* Analyzer::marker_source()
+    {
+        return new File_marker_source(par_->fn_marker_data,
+                par_->undef_allele_code, par_->nthreads, par_->marker_type,
+                par_->marker_data_format);
+    }
+
+    //
+    // Number of markers read ahead of the analysis by a thread of their own,
+    // which only pays off if the hardware runs more than one thread
+    size_t Analyzer::prefetch() const
+    {
+        return boost::thread::hardware_concurrency() > 1 ? par_->prefetch : 0;
     }
 
     void Analyzer::init_filters()
@@ -339,7 +934,9 @@ namespace Permory { namespace gwas {
     }
 
     //
-    // Scan all marker data files and store loci
+    // Scan all marker data files and store loci. The format of each file is
+    // detected once and remembered for the analysis, and the loci are taken
+    // in one pass of the marker data reader.
     void scan_loci(Gwas* the_study, detail::Parameter* par, io::Myout& myout)
     {
         using namespace std;
@@ -356,13 +953,29 @@ namespace Permory { namespace gwas {
             if (dff != unknown) {
                 myout << "assuming file format " << ec.key_to_string<datafile_format>(dff);
                 myout << endl;
-                read_loci(dff, fn, the_study->pointer_to_loci());
+                par->marker_data_format[fn] = dff;
             }
             else {
                 fn_bad_files.insert(fn);
                 myout << "unknown file format - file will be ignored." << endl;
                 continue;
             }
+
+            // Except for the *.bim file of PLINK binary filesets, the loci
+            // are taken from the lines of the markers, skipping their data
+            std::deque<Locus>* loci = the_study->pointer_to_loci();
+            if (dff == plink_bed) {
+                read_loci(dff, fn, loci);
+                continue;
+            }
+            Locus_data_reader<char> reader(fn, par->undef_allele_code,
+                    par->nthreads, par->marker_type, dff);
+            size_t id = loci->empty() ? 1 : loci->back().id() + 1;
+            Locus locus(id);
+            while (reader.get_next(0, &locus)) {
+                loci->push_back(locus);
+                locus = Locus(++id);
+            }
         }
 
         // Deletion of the bad files must be done in a subsequent loop, because
@@ -412,6 +1025,12 @@ namespace Permory { namespace gwas {
         myout << normal << stdpre << m << " markers found." << endl << endl;
 
         myout << normal << stdpre << "Starting analysis..." << endl;
+
+        // The permutation methods count cases only (alleles of cases in
+        // allelic mode), so with up to 255 of them the counts fit into 8
+        // bits, which lets them process twice as many permutations at once
+        typedef unsigned char narrow_count_t;
+        const size_t max_narrow_count = std::numeric_limits<narrow_count_t>::max();
         std::set<char> data_domain;
         switch (par->marker_type) {
             case genotype:  //2x3 contingency table analysis
@@ -423,6 +1042,9 @@ namespace Permory { namespace gwas {
                     if (par->phenotype_domain == Record::continuous) {
                         analyzer->analyze<statistic::Quantitative<3>, double>();
                     }
+                    else if (study.ncase() <= max_narrow_count) {
+                        analyzer->analyze<statistic::Dichotom<2,3,narrow_count_t>, bool>();
+                    }
                     else {
                         analyzer->analyze<statistic::Dichotom<2,3>, bool>();
                     }
@@ -430,7 +1052,12 @@ namespace Permory { namespace gwas {
                 }
             case allelic: //2x2 contingency table analysis
                 boost::shared_ptr<Analyzer> analyzer = factory(par, myout, &study);
-                analyzer->analyze<statistic::Dichotom<2,2>, bool>();
+                if (2*study.ncase() <= max_narrow_count) {
+                    analyzer->analyze<statistic::Dichotom<2,2,narrow_count_t>, bool>();
+                }
+                else {
+                    analyzer->analyze<statistic::Dichotom<2,2>, bool>();
+                }
                 break;
         }
     }
@@ -0,0 +1,127 @@
+// Copyright (c) 2026 The Permory contributors
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt.)
+
+#ifndef permory_gwas_checkpoint_hpp
+#define permory_gwas_checkpoint_hpp
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/serialization/vector.hpp>
+
+#include "detail/config.hpp"
+#include "detail/exception.hpp"
+#include "statistical/exceedance.hpp"
+
+namespace Permory { namespace gwas {
+
+    //
+    // State of a permutation run after a block (--checkpoint), from which it
+    // continues exactly as if it had not been interrupted (--resume). The
+    // test statistics of the markers are not part of it, as they are
+    // computed again in the first block after resuming.
+    //
+    struct Checkpoint {
+        // Ctor
+        Checkpoint()
+            : nperm_total(0), nperm_block(0), seed(0), usePhilox(false),
+            first_perm(0), m(0), perm_todo(0)
+        { }
+
+        // Inspection
+        // Whether both belong to the same run, that is, same parameters
+        bool isSameRun(const Checkpoint& c) const {
+            return nperm_total == c.nperm_total
+                && nperm_block == c.nperm_block
+                && seed == c.seed
+                && usePhilox == c.usePhilox
+                && first_perm == c.first_perm
+                && m == c.m;
+        }
+
+        // The run
+        size_t nperm_total;
+        size_t nperm_block;
+        int seed;
+        bool usePhilox;
+        size_t first_perm;  //number of first permutation (counter-based)
+        size_t m;           //number of markers
+
+        // Its state
+        size_t perm_todo;   //remaining permutations
+        std::vector<char> rng;  //see Permutation::state
+        statistic::Exceedance_counts exceed;
+
+        private:
+        // serialization stuff
+        friend class boost::serialization::access;
+        template<class Archive>
+        void serialize(Archive & ar, const unsigned int version)
+        {
+            ar & nperm_total;
+            ar & nperm_block;
+            ar & seed;
+            ar & usePhilox;
+            ar & first_perm;
+            ar & m;
+            ar & perm_todo;
+            ar & rng;
+            ar & exceed;
+        }
+    };
+
+    //
+    // Write to a temporary file first, which then replaces fn, so that fn
+    // holds a complete checkpoint even if the process dies while writing
+    //
+    inline void write_checkpoint(const Checkpoint& c, const std::string& fn)
+    {
+        std::string tmp = fn + ".tmp";
+        {
+            std::ofstream ofs(tmp.c_str(), std::ios::binary);
+            if (!ofs) {
+                throw detail::File_exception(
+                        "Unable to write checkpoint file: " + tmp);
+            }
+            boost::archive::binary_oarchive oa(ofs);
+            oa << c;
+            ofs.flush();
+            if (!ofs) {
+                throw detail::File_exception(
+                        "Unable to write checkpoint file: " + tmp);
+            }
+        }
+        if (std::rename(tmp.c_str(), fn.c_str()) != 0) {
+            throw detail::File_exception(
+                    "Unable to write checkpoint file: " + fn);
+        }
+    }
+
+    //
+    // Returns false if there is no file fn
+    //
+    inline bool read_checkpoint(const std::string& fn, Checkpoint& c)
+    {
+        std::ifstream ifs(fn.c_str(), std::ios::binary);
+        if (!ifs) {
+            return false;
+        }
+        try {
+            boost::archive::binary_iarchive ia(ifs);
+            ia >> c;
+        }
+        catch (const boost::archive::archive_exception&) {
+            throw detail::File_exception("Invalid checkpoint file: " + fn);
+        }
+        return true;
+    }
+
+} // namespace gwas
+} // namespace Permory
+
+#endif // include guard
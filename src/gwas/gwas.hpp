@@ -54,6 +54,7 @@ namespace Permory { namespace gwas {
             void add_loci(const_iterator start, const_iterator end);
             void resize_loci(size_t n) { if (n < this->m()) loci_.resize(n); }
             void set_meff(const std::deque<double>&, double alpha=0.05, bool Bonf=true);
+            void set_meff(double tperm_alpha, double alpha=0.05, bool Bonf=true);
 
         private:
             std::vector<Individual> ind_;   //recruited individuals
@@ -103,7 +104,15 @@ namespace Permory { namespace gwas {
         // We derive an estimate of the raw p-value threshold from the
         // permutation distribution of t-max statistics. Since vector of test 
         // statistic is sorted in ascending order, take the 1-alpha percentile.
-        double tperm_alpha = tperm[round((1.0-alpha)*tperm.size())];
+        set_meff(tperm[round((1.0-alpha)*tperm.size())], alpha, Bonf);
+    }
+
+    inline void Gwas::set_meff(
+            double tperm_alpha, //1-alpha percentile of the permutation
+                                //distribution
+            double alpha,
+            bool Bonf)
+    {
         double p_raw_estimate = 1.0 - gsl_cdf_chisq_P(tperm_alpha, 1);
 
         if (Bonf) { //Bonferroni
@@ -31,6 +31,12 @@ namespace Permory { namespace gwas {
                     typename std::vector<T>::const_iterator, //start
                     typename std::vector<T>::const_iterator, //end
                     const T&);
+            // Data whose unique elements with counts (as unique_with_counts,
+            // including domain elements of count 0) are known already
+            Locus_data(
+                    const std::vector<T>&,
+                    const std::map<T, count_t>&,
+                    const T&);
 
             // Inspectors
             T get_major() const { return major_; }
@@ -79,10 +85,23 @@ namespace Permory { namespace gwas {
     {
         init();
     }
+    template<class T> inline Locus_data<T>::Locus_data(
+            const std::vector<T>& v, const std::map<T, count_t>& unique,
+            const T& u)
+        : Discrete_data<T>(v, unique), undef_(u)
+    {
+        init();
+    }
     template<class T> inline void Locus_data<T>::init()
     {
-        // determine minor and major allele:
-        std::map<elem_t, count_t> m = this->unique_with_counts();
+        // determine minor and major allele among those in the data:
+        std::map<elem_t, count_t> m;
+        for (typename Discrete_data<T>::unique_iterator it = this->unique_begin();
+                it != this->unique_end(); ++it) {
+            if (it->second > 0) {
+                m.insert(*it);
+            }
+        }
         m.erase(undef_); //undefined is not allowed
         minor_ =  (*std::min_element(m.begin(), m.end(), 
                     detail::comp_second<std::pair<elem_t, count_t> >())).first;
@@ -0,0 +1,237 @@
+// Copyright (c) 2026 The Permory contributors
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt.)
+
+#ifndef permory_gwas_marker_source_hpp
+#define permory_gwas_marker_source_hpp
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "detail/config.hpp"
+#include "detail/exception.hpp"
+#include "locusdata.hpp"
+#include "read_locus_data.hpp"
+
+namespace Permory { namespace gwas {
+
+    //
+    // Yields the data of all markers in the order of the marker data files
+    // and of the markers within them
+    //
+    class Marker_source {
+        public:
+            // Dtor
+            virtual ~Marker_source() { }
+
+            // Conversion
+            // Data of the next marker, owned by the caller, or 0 at the end
+            virtual Locus_data<char>* next() = 0;
+    };
+
+    //
+    // Reads and parses the marker data files one after another. Files of a
+    // known format (e.g. detected while scanning the loci) are not detected
+    // again.
+    //
+    class File_marker_source : public Marker_source {
+        public:
+            typedef std::map<std::string, detail::datafile_format> Formats;
+
+            // Ctor
+            File_marker_source(const std::set<std::string>& fn, char undef,
+                    size_t nthreads=1,  //threads decompressing a file
+                    detail::Marker_type mt=detail::allelic,
+                    const Formats& formats=Formats())
+                : fn_(fn), itFile_(fn_.begin()), undef_(undef),
+                nthreads_(nthreads), mt_(mt), formats_(formats)
+            { }
+
+            // Conversion
+            Locus_data<char>* next();
+
+        private:
+            const std::set<std::string> fn_;
+            std::set<std::string>::const_iterator itFile_;
+            boost::scoped_ptr<Locus_data_reader<char> > reader_;
+            char undef_;
+            size_t nthreads_;
+            detail::Marker_type mt_;
+            const Formats formats_;
+    };
+
+    //
+    // Takes the markers of another source on a thread of its own, which
+    // prepares each one (e.g. checks it) and runs ahead of the reader by up
+    // to capacity markers, so that reading and parsing overlap with the
+    // analysis. The order of the markers is kept. With capacity 0, markers
+    // are taken and prepared by the reader.
+    //
+    class Prefetching_marker_source : public Marker_source {
+        public:
+            typedef boost::function<void (Locus_data<char>&)> Preparation;
+
+            // Ctor + Dtor
+            Prefetching_marker_source(
+                    Marker_source* source,      //owned
+                    size_t capacity=64,
+                    const Preparation& prepare=Preparation());
+            ~Prefetching_marker_source();
+
+            // Conversion
+            Locus_data<char>* next();
+
+        private:
+            Locus_data<char>* fetch();  //next of source_, prepared
+            void produce();
+
+            boost::scoped_ptr<Marker_source> source_;
+            size_t capacity_;
+            Preparation prepare_;
+            std::deque<Locus_data<char>*> queue_;   //owned
+            bool isEnd_;        //producer got the end
+            bool stop_;
+            bool hasError_;
+            std::string error_;
+            boost::scoped_ptr<detail::Data_length_mismatch_error> mismatch_;
+            boost::mutex mutex_;
+            boost::condition_variable changed_;
+            boost::scoped_ptr<boost::thread> thread_;
+    };
+
+    // ========================================================================
+    // File_marker_source implementation
+    inline Locus_data<char>* File_marker_source::next()
+    {
+        std::vector<char> v;
+        while (true) {
+            while (not reader_ || not reader_->hasData()) {
+                if (itFile_ == fn_.end()) {
+                    reader_.reset();
+                    return 0;
+                }
+                Formats::const_iterator it = formats_.find(*itFile_);
+                reader_.reset(new Locus_data_reader<char>(*itFile_++, undef_,
+                            nthreads_, mt_, it == formats_.end() ?
+                            detail::unknown : it->second));
+            }
+            if (reader_->get_next(&v, 0)) {  //else only comments were left
+                return new Locus_data<char>(v, reader_->undef());
+            }
+        }
+    }
+
+    // ========================================================================
+    // Prefetching_marker_source implementation
+    inline Prefetching_marker_source::Prefetching_marker_source(
+            Marker_source* source, size_t capacity, const Preparation& prepare)
+        : source_(source), capacity_(capacity), prepare_(prepare),
+        isEnd_(false), stop_(false), hasError_(false)
+    {
+        if (capacity_ > 0) {
+            thread_.reset(new boost::thread(
+                        boost::bind(&Prefetching_marker_source::produce, this)));
+        }
+    }
+
+    inline Prefetching_marker_source::~Prefetching_marker_source()
+    {
+        if (thread_) {
+            {
+                boost::mutex::scoped_lock lock(mutex_);
+                stop_ = true;
+            }
+            changed_.notify_all();
+            thread_->join();
+        }
+        for (size_t i=0; i<queue_.size(); ++i) {
+            delete queue_[i];
+        }
+    }
+
+    inline Locus_data<char>* Prefetching_marker_source::next()
+    {
+        if (not thread_) {
+            return this->fetch();
+        }
+        boost::mutex::scoped_lock lock(mutex_);
+        while (queue_.empty() && not isEnd_ && not hasError_) {
+            changed_.wait(lock);
+        }
+        if (not queue_.empty()) {   //errors come after the markers before
+            Locus_data<char>* p = queue_.front();
+            queue_.pop_front();
+            changed_.notify_all();
+            return p;
+        }
+        if (mismatch_) {
+            throw detail::Data_length_mismatch_error(*mismatch_);
+        }
+        if (hasError_) {
+            throw std::runtime_error(error_);
+        }
+        return 0;
+    }
+
+    inline Locus_data<char>* Prefetching_marker_source::fetch()
+    {
+        std::auto_ptr<Locus_data<char> > p(source_->next());
+        if (p.get() && not prepare_.empty()) {
+            prepare_(*p);
+        }
+        return p.release();
+    }
+
+    //
+    // Loop of the thread: keep the queue filled until the end of the source
+    inline void Prefetching_marker_source::produce()
+    {
+        try {
+            while (true) {
+                std::auto_ptr<Locus_data<char> > p(this->fetch());
+                boost::mutex::scoped_lock lock(mutex_);
+                while (queue_.size() >= capacity_ && not stop_) {
+                    changed_.wait(lock);
+                }
+                if (stop_) {
+                    return;
+                }
+                if (not p.get()) {
+                    isEnd_ = true;
+                    changed_.notify_all();
+                    return;
+                }
+                queue_.push_back(p.release());
+                changed_.notify_all();
+            }
+        }
+        catch (const detail::Data_length_mismatch_error& e) {
+            boost::mutex::scoped_lock lock(mutex_);
+            mismatch_.reset(new detail::Data_length_mismatch_error(e));
+            hasError_ = true;
+            changed_.notify_all();
+        }
+        catch (const std::exception& e) {
+            boost::mutex::scoped_lock lock(mutex_);
+            error_ = e.what();
+            hasError_ = true;
+            changed_.notify_all();
+        }
+    }
+
+} // namespace gwas
+} // namespace Permory
+
+#endif // include guard
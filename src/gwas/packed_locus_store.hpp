@@ -0,0 +1,174 @@
+// Copyright (c) 2026 The Permory contributors
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt.)
+
+#ifndef permory_gwas_packed_locus_store_hpp
+#define permory_gwas_packed_locus_store_hpp
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/serialization/vector.hpp>
+
+#include "detail/config.hpp"
+#include "locusdata.hpp"
+
+namespace Permory { namespace gwas {
+
+    //
+    // Keeps the data of many loci in memory using as few bits as possible.
+    // Each locus gets its own code table holding its domain (in the order of
+    // Locus_data::unique_begin) with the counts of its elements, and each
+    // data value is stored as its index in that table. With up to 4 domain
+    // elements, as usual for genotypes (e.g. '0', '1', '2' and the undefined
+    // code) or alleles, this takes 2 bits per value; otherwise a full byte is
+    // used. The counts spare counting the data again when they are got.
+    //
+    class Packed_locus_store {
+        public:
+            // Ctor
+            Packed_locus_store() { }
+
+            // Inspection
+            size_t size() const { return loci_.size(); }
+            bool empty() const { return loci_.empty(); }
+            size_t nbytes() const { return bytes_.size(); } //packed data only
+
+            // Modification
+            void add(const Locus_data<char>&);
+            void clear();
+
+            // Conversion
+            // The returned Locus_data equals the added one in data and domain
+            Locus_data<char>* get(size_t i) const;
+            // Same, decoding into scratch, which is reused from call to call
+            Locus_data<char>* get(size_t i, std::vector<char>& scratch) const;
+
+        private:
+            struct Entry {
+                size_t offset;          //first byte in bytes_
+                size_t length;          //number of data values
+                char undef;             //code of undefined value
+                std::vector<char> table;//domain, i.e. code -> value
+                std::vector<Locus_data<char>::count_t> count; //per code
+
+                template<class Archive>
+                void serialize(Archive & ar, const unsigned int version)
+                {
+                    ar & offset;
+                    ar & length;
+                    ar & undef;
+                    ar & table;
+                    ar & count;
+                }
+            };
+            std::vector<Entry> loci_;
+            std::vector<unsigned char> bytes_;
+
+            // serialization stuff
+            friend class boost::serialization::access;
+            template<class Archive>
+            void serialize(Archive & ar, const unsigned int version)
+            {
+                ar & loci_;
+                ar & bytes_;
+            }
+    };
+
+    // ========================================================================
+    // Packed_locus_store implementation
+    inline void Packed_locus_store::add(const Locus_data<char>& data)
+    {
+        Entry e;
+        e.offset = bytes_.size();
+        e.length = data.size();
+        e.undef = data.get_undef();
+        for (Locus_data<char>::unique_iterator it = data.unique_begin();
+                it != data.unique_end(); ++it) {
+            e.table.push_back(it->first);
+            e.count.push_back(it->second);
+        }
+        if (e.table.size() > 256) {
+            throw std::length_error("Too many distinct values for packed locus.");
+        }
+
+        // Map each possible char to its code
+        unsigned char code[256];
+        for (size_t i=0; i<e.table.size(); ++i) {
+            code[(unsigned char) e.table[i]] = (unsigned char) i;
+        }
+
+        if (e.length == 0) {
+            // nothing to store
+        }
+        else if (e.table.size() <= 4) {
+            bytes_.resize(e.offset + (e.length + 3)/4, 0);
+            unsigned char* p = &bytes_[0] + e.offset;
+            for (size_t i=0; i<e.length; ++i) {
+                p[i/4] |= code[(unsigned char) data[i]] << 2*(i%4);
+            }
+        }
+        else {
+            bytes_.reserve(e.offset + e.length);
+            for (size_t i=0; i<e.length; ++i) {
+                bytes_.push_back(code[(unsigned char) data[i]]);
+            }
+        }
+        loci_.push_back(e);
+    }
+
+    inline void Packed_locus_store::clear()
+    {
+        loci_.clear();
+        bytes_.clear();
+    }
+
+    inline Locus_data<char>* Packed_locus_store::get(size_t i) const
+    {
+        std::vector<char> v;
+        return this->get(i, v);
+    }
+
+    inline Locus_data<char>* Packed_locus_store::get(size_t i,
+            std::vector<char>& v) const
+    {
+        assert(i < loci_.size());
+        const Entry& e = loci_[i];
+        v.resize(e.length);
+        const unsigned char* p = e.length > 0 ? &bytes_[e.offset] : 0;
+        if (e.table.size() <= 4) {
+            // Decode 4 values per byte
+            char val[4] = {0, 0, 0, 0};
+            std::copy(e.table.begin(), e.table.end(), val);
+            size_t n = e.length/4;
+            for (size_t j=0; j<n; ++j) {
+                unsigned char b = p[j];
+                v[4*j] = val[b & 3];
+                v[4*j + 1] = val[(b >> 2) & 3];
+                v[4*j + 2] = val[(b >> 4) & 3];
+                v[4*j + 3] = val[b >> 6];
+            }
+            for (size_t j=4*n; j<e.length; ++j) {
+                v[j] = val[(p[j/4] >> 2*(j%4)) & 3];
+            }
+        }
+        else {
+            for (size_t j=0; j<e.length; ++j) {
+                v[j] = e.table[p[j]];
+            }
+        }
+        // The domain, including elements not present in the data, with the
+        // counts of the added data
+        std::map<char, Locus_data<char>::count_t> unique;
+        for (size_t j=0; j<e.table.size(); ++j) {
+            unique.insert(unique.end(), std::make_pair(e.table[j], e.count[j]));
+        }
+        return new Locus_data<char>(v, unique, e.undef);
+    }
+
+} // namespace gwas
+} // namespace Permory
+
+#endif // include guard
@@ -5,18 +5,21 @@
 #ifndef permory_io_read_locus_data_hpp
 #define permory_io_read_locus_data_hpp
 
+#include <cstdlib>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <deque>
 
 #include "boost/lexical_cast.hpp"
+#include "boost/scoped_ptr.hpp"
 
 #include "detail/config.hpp"
 #include "detail/exception.hpp"
 #include "io/format_detect.hpp"
 #include "io/line_reader.hpp"
-#include "io/input_filters.hpp"
+#include "io/plink_bed.hpp"
+#include "io/tokenizer.hpp"
 
 namespace Permory { namespace gwas {
     template<class T> class Locus_data_reader {
@@ -24,82 +27,179 @@ namespace Permory { namespace gwas {
             // Ctor
             Locus_data_reader(
                     const std::string&, //file name
-                    char mc='?');       //the character for the missing value
+                    char mc='?',        //the character for the missing value
+                    size_t nthreads=1,  //threads decompressing the file
+                    detail::Marker_type mt=detail::allelic,
+                    detail::datafile_format format=detail::unknown); //detect
+
 
             // Inspection
-            bool hasData() const { return !lr_.eof(); }
+            bool hasData() const { return bed_ ? bed_->hasNext() : !lr_->eof(); }
             detail::datafile_format get_format() const { return format_; }
+            // The character for the missing value in the data got last: '?'
+            // for genotypes of PLINK *.bed files (as condensed alleles)
+            char undef() const { return undef_; }
 
             // Conversion
             size_t get_next(std::vector<T>&);
+            // Same, and the information of the locus (as read_loci; only
+            // its id for PLINK *.bed files, see there). Without v, the data
+            // are skipped. False if there are no more markers.
+            bool get_next(std::vector<T>* v, Locus* locus);
 
         private:
+            bool next_marker(std::vector<T>*, Locus*, size_t& nskipped);
+
             detail::datafile_format format_;
-            io::Line_reader<T> lr_;
+            char mc_;
+            char undef_;
+            detail::Marker_type mt_;
+            boost::scoped_ptr<io::Line_reader<T> > lr_;
+            boost::scoped_ptr<io::Bed_reader> bed_;
     };
 
     // Locus_data_reader<T> implementation
     // ========================================================================
     template<class T> inline Locus_data_reader<T>::Locus_data_reader(
-            const std::string& fn, char mc)
-        : lr_(fn)
+            const std::string& fn, char mc, size_t nthreads,
+            detail::Marker_type mt, detail::datafile_format format)
+        : format_(format), mc_(mc), undef_(mc), mt_(mt)
     {
-        this->format_ = io::detect_marker_data_format(fn, mc);
+        if (format_ == detail::unknown) {
+            this->format_ = io::detect_marker_data_format(fn, mc);
+        }
 
         if (format_ == detail::unknown) {
             throw std::runtime_error("Unknown data format.");
         }
+        if (format_ == detail::plink_bed) {
+            bed_.reset(new io::Bed_reader(fn));
+        }
+        else {
+            lr_.reset(new io::Line_reader<T>(fn, nthreads));
+        }
     }
 
-    template<> inline size_t Locus_data_reader<char>::get_next(std::vector<char>& v)
+    template<> inline bool Locus_data_reader<char>::next_marker(
+            std::vector<char>* v, Locus* locus, size_t& nskipped)
     {
         using namespace Permory::detail;
-        size_t nskipped = 0;
-        v.clear();
-        v.reserve(lr_.size());
+        if (v) {
+            v->clear();
+        }
+        if (bed_) {     //binary, straight to genotypes if these are analyzed
+            if (not bed_->hasNext()) {
+                return false;
+            }
+            if (not v) {
+                bed_->seek(bed_->tell() + 1);
+            }
+            else if (mt_ == genotype) {
+                bed_->next_genotypes(*v, mc_);
+                undef_ = '?';
+            }
+            else {
+                bed_->next_alleles(*v, mc_);
+            }
+            return true;
+        }
+        const io::Delimiters white(' ', '\t', '\r');
 
         while (hasData()) {   
-            lr_.next();
-            if (*lr_.begin() == '#') {
+            lr_->next();
+            if (*lr_->begin() == '#') {
                 nskipped++;
                 continue;   //skip comments
             }
 
+            // Where the data start in the line and what delimits them
+            const char* first = lr_->begin();
+            const char* last = lr_->end();
+            const char* data = first;
+            io::Delimiters delims(' ');
             switch(format_) {
                 case compact: //straight copy
-                    std::copy(lr_.begin(), lr_.end(), std::back_inserter(v)); 
                     break;
                 case slide: //white space delimiters
-                    std::remove_copy(lr_.begin(), lr_.end(), 
-                            std::back_inserter(v), ' ');
                     break; 
                 case presto: //skip first two chunks and white space delims thereafter
-                    if (*(lr_.begin()) != 'M') {
+                    if (*first != 'M') {
                         nskipped++;
                         continue;
                     }
-                    std::remove_copy_if(lr_.begin(), lr_.end(), 
-                            std::back_inserter(v), io::Skip_input_filter<2>());
+                    data = io::skip_chunks(first, last, 2, white);
+                    delims = white;
                     break;
                 case plink_tped: //skip first four chunks and white space delims thereafter
-                    std::remove_copy_if(lr_.begin(), lr_.end(), 
-                            std::back_inserter(v), io::Skip_input_filter<4>());
+                    data = io::skip_chunks(first, last, 4, white);
+                    delims = white;
                     break;
                 default:
                     throw std::invalid_argument("Data format not supported.\n");
             }
-            if (not v.empty()) {
-                break;
+
+            // The characters are packed straight into v, which has room for
+            // the whole line. Without v, only whether there are any counts.
+            bool isEmpty;
+            if (v) {
+                v->resize(last - data + 1);
+                char* out = &(*v)[0];
+                out = format_ == compact ? std::copy(data, last, out) :
+                    io::remove_delimiters(data, last, out, delims);
+                v->resize(out - &(*v)[0]);
+                isEmpty = v->empty();
             }
+            else {
+                const char* p = data;
+                while (format_ != compact && p != last && delims(*p)) {
+                    ++p;
+                }
+                isEmpty = p == last;
+            }
+            if (isEmpty) {
+                continue;
+            }
+
+            if (locus) {    //same as read_loci
+                std::string chunk[4];
+                for (size_t i=0; i<4 && first != last; ++i) {
+                    first = io::next_chunk(first, last, white, chunk[i]);
+                }
+                if (format_ == presto) {    //M and the marker name
+                    *locus = Locus(locus->id(), chunk[1]);
+                }
+                if (format_ == plink_tped) {    //chr, rs, cM, bp
+                    *locus = Locus(locus->id(), chunk[1], "",
+                            string2chr(chunk[0]),
+                            std::strtoul(chunk[3].c_str(), 0, 10),
+                            std::strtod(chunk[2].c_str(), 0));
+                }
+            }
+            return true;
         }
+        return false;
+    }
+
+    template<> inline size_t Locus_data_reader<char>::get_next(std::vector<char>& v)
+    {
+        size_t nskipped = 0;
+        this->next_marker(&v, 0, nskipped);
         return nskipped;
     }
 
+    template<> inline bool Locus_data_reader<char>::get_next(
+            std::vector<char>* v, Locus* locus)
+    {
+        size_t nskipped = 0;
+        return this->next_marker(v, locus, nskipped);
+    }
+
     // ========================================================================
     //
     // Read loci information from file. Supports PERMORY, PRESTO, PLINK, and 
     // SLIDE where in case of SLIDE, the loci names are simply formed by the 
-    // ID. All newly read loci are appended to the loci deque.
+    // ID. For PLINK *.bed files, the loci are read from the *.bim file. All
+    // newly read loci are appended to the loci deque.
     //
     void read_loci(const detail::datafile_format& format, const std::string& fn, 
             //std::back_insert_iterator<std::deque<Locus> > loci_back)
@@ -109,7 +209,8 @@ namespace Permory { namespace gwas {
         using namespace Permory::io;
         using namespace Permory::detail;
 
-        io::Line_reader<string> lr(fn);
+        io::Line_reader<string> lr(format == plink_bed ?
+                plink_fileset_file(fn, ".bim") : fn);
         string line;
         size_t id = 1;
         if (not loci->empty()) {
@@ -136,6 +237,7 @@ namespace Permory { namespace gwas {
                     }
                     break;
                 case plink_tped: //read from trans.tped file
+                case plink_bed:  //*.bim file starts with the same columns
                     if (line[0] != '#') {   //skip comments
                         istringstream iss(line);
                         string chr;     //chromosome
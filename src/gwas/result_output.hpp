@@ -8,6 +8,7 @@
 #include "gwas.hpp"
 #include "io/file_out.hpp"
 #include "io/output.hpp"
+#include "statistical/gpd.hpp"
 #include "statistical/pvalue.hpp"
 
 namespace Permory { namespace gwas {
@@ -56,7 +57,8 @@ namespace Permory { namespace gwas {
             detail::Parameter* par, 
             const Gwas& study, 
             const std::deque<size_t>& pval_cnts,
-            const std::string& fn)
+            const std::string& fn,
+            const statistic::Gpd_tail* tail=0) //tail fit, if any
     {
         using namespace std;
         using namespace detail;
@@ -120,6 +122,11 @@ namespace Permory { namespace gwas {
         if (par->pval_counts) {
             out << right << setw(10) << "P.counts";
         }
+        if (tail) {
+            out << right << setw(14) << "P_gpd" <<
+                right << setw(14) << "P_gpd_low" <<
+                right << setw(14) << "P_gpd_high";
+        }
         out << endl;
 
         // Write results
@@ -155,6 +162,21 @@ namespace Permory { namespace gwas {
                 if (par->pval_counts) {
                     out << right << setw(10) << *itPcnt;
                 }
+                if (tail) {
+                    // Only where the permutations are too few for P_adjusted
+                    if (tail->isFitted() && *itPcnt < Gpd_tail::max_count) {
+                        pair<double, double> ci = tail->interval(itLoc->tmax());
+                        out << right << setw(14) << setprecision(4) <<
+                            scientific << tail->pvalue(itLoc->tmax()) <<
+                            right << setw(14) << ci.first <<
+                            right << setw(14) << ci.second << fixed;
+                    }
+                    else {
+                        out << right << setw(14) << "NA" <<
+                            right << setw(14) << "NA" <<
+                            right << setw(14) << "NA";
+                    }
+                }
             }
             else {
                 for (size_t i=0; i<ntest; ++i) {
@@ -168,6 +190,11 @@ namespace Permory { namespace gwas {
                 if (par->pval_counts) {
                     out << right << setw(10) << "NA";
                 }
+                if (tail) {
+                    out << right << setw(14) << "NA" <<
+                        right << setw(14) << "NA" <<
+                        right << setw(14) << "NA";
+                }
             }
             out << endl;
             itPadj++;
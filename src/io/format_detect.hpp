@@ -11,6 +11,7 @@
 #include "detail/parameter.hpp" 
 #include "io/file.hpp" 
 #include "io/line_reader.hpp" 
+#include "io/plink_bed.hpp"
 
 namespace Permory { namespace io {
 
@@ -29,6 +30,9 @@ namespace Permory { namespace io {
             char mc='?')            //the character for the missing value
     {
         using namespace detail;
+        if (is_plink_bed(fn)) {     //binary, the others are text
+            return plink_bed;
+        }
         Line_reader<char> lr(fn);
         while (!lr.eof()) {
             lr.next();
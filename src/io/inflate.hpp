@@ -0,0 +1,347 @@
+// Copyright (c) 2026 The Permory contributors
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt.)
+
+#ifndef permory_io_inflate_hpp
+#define permory_io_inflate_hpp
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+#include <boost/bind.hpp>
+#include <boost/iostreams/device/file.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "detail/config.hpp"
+#include "detail/exception.hpp"
+#include "detail/thread_team.hpp"
+
+namespace Permory { namespace io {
+
+    //
+    // Decompressed data of a file, piece by piece
+    //
+    class Inflater : boost::noncopyable {
+        public:
+            // Dtor
+            virtual ~Inflater() { }
+
+            // Conversion
+            // Next piece, valid until the next call; false at the end
+            virtual bool next(const char*& first, const char*& last) = 0;
+    };
+
+    namespace inflate_detail {
+        inline size_t uint16_at(const unsigned char* p) {
+            return size_t(p[0]) | size_t(p[1]) << 8;
+        }
+        inline size_t uint32_at(const unsigned char* p) {
+            return uint16_at(p) | uint16_at(p + 2) << 16;
+        }
+
+        //
+        // Size of the BGZF block whose gzip header (12 bytes plus the extra
+        // field of xlen bytes) is given, or 0 if it is no BGZF block
+        //
+        inline size_t bgzf_block_size(const unsigned char* header,
+                const unsigned char* extra, size_t xlen)
+        {
+            if (header[0] != 31 || header[1] != 139 || header[2] != 8
+                    || (header[3] & 4) == 0) {
+                return 0;
+            }
+            for (size_t i=0; i+4<=xlen; i+=4+uint16_at(extra + i + 2)) {
+                if (extra[i] == 'B' && extra[i + 1] == 'C'
+                        && uint16_at(extra + i + 2) == 2 && i + 6 <= xlen) {
+                    return uint16_at(extra + i + 4) + 1;
+                }
+            }
+            return 0;
+        }
+    } // namespace inflate_detail
+
+    //
+    // Whether the file is BGZF (blocked gzip, as written by bgzip of
+    // samtools/htslib): gzip members of at most 64 KB, each of which tells
+    // its compressed size in the header, so they can be inflated in parallel
+    //
+    inline bool is_bgzf(const std::string& fn)
+    {
+        std::ifstream ifs(fn.c_str(), std::ios::binary);
+        unsigned char header[12];
+        if (not ifs.read(reinterpret_cast<char*>(header), 12)) {
+            return false;
+        }
+        size_t xlen = inflate_detail::uint16_at(header + 10);
+        std::vector<unsigned char> extra(xlen + 1);
+        if (not ifs.read(reinterpret_cast<char*>(&extra[0]), xlen)) {
+            return false;
+        }
+        return inflate_detail::bgzf_block_size(header, &extra[0], xlen) > 0;
+    }
+
+    //
+    // Inflates a BGZF file in batches of blocks, whose blocks are inflated
+    // in parallel by a team of threads
+    //
+    class Bgzf_inflater : public Inflater {
+        public:
+            // Ctor
+            Bgzf_inflater(const std::string& fn, size_t nthreads=1);
+
+            // Conversion
+            bool next(const char*& first, const char*& last);
+
+        private:
+            bool read_batch();
+            void inflate_share(size_t);     //of thread i
+            void inflate(size_t);
+
+            std::string fn_;
+            std::ifstream ifs_;
+            detail::Thread_team team_;
+            std::vector<std::vector<unsigned char> > in_;   //compressed blocks
+            std::vector<std::vector<char> > out_;
+            size_t nblocks_;    //in current batch
+            size_t current_;    //next block of the batch to hand out
+    };
+
+    //
+    // Inflates a gzip file with a thread of its own, which runs ahead of
+    // the reader by up to nbuffers pieces
+    //
+    class Gzip_pipe : public Inflater {
+        public:
+            // Ctor + Dtor
+            explicit Gzip_pipe(
+                    const std::string& fn,
+                    size_t nbuffers=4,
+                    size_t buffer_size=size_t(1) << 18);
+            ~Gzip_pipe();
+
+            // Conversion
+            bool next(const char*& first, const char*& last);
+
+        private:
+            void produce();
+
+            boost::iostreams::filtering_istreambuf in_;
+            std::vector<std::vector<char> > buf_;
+            std::vector<std::streamsize> size_; //of the data in buf_
+            size_t head_;       //next buffer of the reader
+            size_t tail_;       //next buffer of the producer
+            size_t nfull_;      //buffers filled and not yet released
+            bool isHeld_;       //reader holds buffer head_
+            bool isEnd_;        //reader got the end
+            bool stop_;
+            bool hasError_;
+            std::string error_;
+            boost::mutex mutex_;
+            boost::condition_variable changed_;
+            boost::scoped_ptr<boost::thread> thread_;
+    };
+
+    // ========================================================================
+    // Bgzf_inflater implementation
+    inline Bgzf_inflater::Bgzf_inflater(const std::string& fn, size_t nthreads)
+        : fn_(fn), ifs_(fn.c_str(), std::ios::binary), team_(nthreads),
+        in_(4*team_.size()), out_(4*team_.size()), nblocks_(0), current_(0)
+    {
+        if (not ifs_) {
+            throw detail::File_exception(fn + ": unable to open file.");
+        }
+    }
+
+    inline bool Bgzf_inflater::next(const char*& first, const char*& last)
+    {
+        if (current_ == nblocks_) {
+            if (not read_batch()) {
+                return false;
+            }
+        }
+        std::vector<char>& v = out_[current_++];
+        first = v.empty() ? 0 : &v[0];
+        last = first + v.size();
+        return true;
+    }
+
+    inline void Bgzf_inflater::inflate_share(size_t i)
+    {
+        for (size_t k=i; k<nblocks_; k+=team_.size()) {
+            inflate(k);
+        }
+    }
+
+    //
+    // Read the next blocks from the file and inflate them
+    inline bool Bgzf_inflater::read_batch()
+    {
+        using namespace inflate_detail;
+        nblocks_ = 0;
+        current_ = 0;
+        while (nblocks_ < in_.size()) {
+            std::vector<unsigned char>& v = in_[nblocks_];
+            v.resize(12);
+            if (not ifs_.read(reinterpret_cast<char*>(&v[0]), 12)) {
+                break;
+            }
+            size_t xlen = uint16_at(&v[10]);
+            v.resize(12 + xlen);
+            if (not ifs_.read(reinterpret_cast<char*>(&v[0]) + 12, xlen)) {
+                throw detail::File_exception(fn_ + ": truncated BGZF block.");
+            }
+            size_t bsize = bgzf_block_size(&v[0], &v[0] + 12, xlen);
+            if (bsize < 12 + xlen + 8) {
+                throw detail::File_exception(fn_ + ": invalid BGZF block.");
+            }
+            v.resize(bsize);
+            if (not ifs_.read(reinterpret_cast<char*>(&v[12 + xlen]),
+                        bsize - 12 - xlen)) {
+                throw detail::File_exception(fn_ + ": truncated BGZF block.");
+            }
+            nblocks_++;
+        }
+        team_.run(boost::bind(&Bgzf_inflater::inflate_share, this, _1));
+        return nblocks_ > 0;
+    }
+
+    inline void Bgzf_inflater::inflate(size_t k)
+    {
+        using namespace inflate_detail;
+        const std::vector<unsigned char>& v = in_[k];
+        size_t header = 12 + uint16_at(&v[10]);
+        size_t isize = uint32_at(&v[v.size() - 4]);
+        size_t crc = uint32_at(&v[v.size() - 8]);
+        std::vector<char>& out = out_[k];
+        out.resize(isize);
+        if (isize == 0) {   //e.g. the end-of-file marker
+            return;
+        }
+
+        z_stream zs;
+        zs.zalloc = Z_NULL;
+        zs.zfree = Z_NULL;
+        zs.opaque = Z_NULL;
+        zs.next_in = const_cast<Bytef*>(&v[header]);
+        zs.avail_in = uInt(v.size() - header - 8);
+        zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+        zs.avail_out = uInt(isize);
+        if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) {  //raw deflate data
+            throw std::runtime_error("Unable to initialize zlib.");
+        }
+        int ret = ::inflate(&zs, Z_FINISH);
+        inflateEnd(&zs);
+        if (ret != Z_STREAM_END || zs.total_out != isize
+                || crc32(0, reinterpret_cast<Bytef*>(&out[0]), uInt(isize)) != crc) {
+            throw std::runtime_error(fn_ + ": corrupt BGZF block.");
+        }
+    }
+
+    // ========================================================================
+    // Gzip_pipe implementation
+    inline Gzip_pipe::Gzip_pipe(const std::string& fn, size_t nbuffers,
+            size_t buffer_size)
+        : buf_(std::max(nbuffers, size_t(2)), std::vector<char>(buffer_size)),
+        size_(buf_.size(), 0), head_(0), tail_(0), nfull_(0),
+        isHeld_(false), isEnd_(false), stop_(false), hasError_(false)
+    {
+        namespace bio = boost::iostreams;
+        in_.push(bio::gzip_decompressor());
+        in_.push(bio::file_source(fn));
+        if (not in_.component<bio::file_source>(1)->is_open()) {
+            throw detail::File_exception(fn + ": unable to open file.");
+        }
+        thread_.reset(new boost::thread(boost::bind(&Gzip_pipe::produce, this)));
+    }
+
+    inline Gzip_pipe::~Gzip_pipe()
+    {
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            stop_ = true;
+        }
+        changed_.notify_all();
+        thread_->join();
+    }
+
+    inline bool Gzip_pipe::next(const char*& first, const char*& last)
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        if (isEnd_) {
+            return false;
+        }
+        if (isHeld_) {      //release the previous one
+            head_ = (head_ + 1) % buf_.size();
+            nfull_--;
+            isHeld_ = false;
+            changed_.notify_all();
+        }
+        while (nfull_ == 0 && not hasError_) {
+            changed_.wait(lock);
+        }
+        if (hasError_) {
+            throw std::runtime_error(error_);
+        }
+        isHeld_ = true;
+        if (size_[head_] <= 0) {    //the end
+            isEnd_ = true;
+            return false;
+        }
+        first = &buf_[head_][0];
+        last = first + size_[head_];
+        return true;
+    }
+
+    //
+    // Loop of the thread: fill the free buffers, the last one with no data
+    inline void Gzip_pipe::produce()
+    {
+        try {
+            while (true) {
+                size_t i;
+                {
+                    boost::mutex::scoped_lock lock(mutex_);
+                    while (nfull_ == buf_.size() && not stop_) {
+                        changed_.wait(lock);
+                    }
+                    if (stop_) {
+                        return;
+                    }
+                    i = tail_;
+                }
+                std::streamsize n = in_.sgetn(&buf_[i][0], buf_[i].size());
+                {
+                    boost::mutex::scoped_lock lock(mutex_);
+                    size_[i] = n;
+                    tail_ = (tail_ + 1) % buf_.size();
+                    nfull_++;
+                }
+                changed_.notify_all();
+                if (n <= 0) {
+                    return;
+                }
+            }
+        }
+        catch (const std::exception& e) {
+            {
+                boost::mutex::scoped_lock lock(mutex_);
+                error_ = e.what();
+                hasError_ = true;
+            }
+            changed_.notify_all();
+        }
+    }
+
+} // namespace io
+} // namespace Permory
+
+#endif // include guard
@@ -5,20 +5,31 @@
 #ifndef permory_io_line_reader_hpp
 #define permory_io_line_reader_hpp
 
+#include <algorithm>
+#include <cstring>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <zlib.h>
 
+#if !(defined(_WINDOWS) || defined(_WIN32) || defined(__WIN32__) || defined(_WIN64))
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include <boost/iostreams/device/file.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
 #include <boost/iostreams/filter/zlib.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
 #include <boost/iostreams/stream.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include "detail/config.hpp"
 #include "detail/exception.hpp"
 #include "io/file.hpp"
+#include "io/inflate.hpp"
 #include "io/input_filters.hpp"
 
 namespace Permory { namespace io {
@@ -131,7 +142,14 @@ namespace Permory { namespace io {
     }
 
 
-    // Specialization to char for increased performance
+    // Specialization to char for increased performance: uncompressed files
+    // are memory-mapped and a line is just a view into the mapping, so
+    // nothing is copied, while compressed ones are decompressed in chunks:
+    // BGZF files by nthreads threads, other gzip files by a thread running
+    // ahead of the reader if nthreads > 1.
+    // Line ends are searched with memchr, which the C library vectorizes.
+    // At least line_padding characters can be read beyond the end of any
+    // line (the rest of the file or zeros).
     // ========================================================================
     const size_t BUFFSIZE = 65536; 
     template<> class Line_reader<char> {
@@ -139,51 +157,76 @@ namespace Permory { namespace io {
             typedef char char_t;
 
             // Iterator pass through
-            typedef std::vector<char>::const_iterator const_iterator;
-            const_iterator begin() const { return buf_.begin(); }
-            const_iterator end() const { return buf_.end(); }
+            typedef const char* const_iterator;
+            const_iterator begin() const { return first_; }
+            const_iterator end() const { return last_; }
 
             //  Ctor and Dtor
-            Line_reader(const std::string& fn); 
-            ~Line_reader() { in_.reset(); } //close all devices
+            Line_reader(const std::string& fn, size_t nthreads=1); 
+            ~Line_reader();
 
             // Modification
             void next();    //read next line 
             void skip();    //skip one line
 
             // Inspection
-            bool empty() const { return buf_.empty(); }
-            bool eof() const { return it_ == eos_; }
-            size_t size() const { return buf_.size(); }
+            bool empty() const { return first_ == last_; }
+            bool eof() const { return pos_ == end_; }
+            size_t size() const { return last_ - first_; }
             size_t char_count() const { return charCount_; }
             size_t line_count() const { return lineCount_; }
             const File_handle get_file() const { return file_; }
 
+            static const size_t line_padding = 4;
+
         private:
+            bool map_file(const std::string&);
+            bool fill();    //next chunk of the stream
+
             File_handle file_;
-            std::vector<char> buf_; //line buffer
+            std::vector<char> buf_; //copy of the line, if not a view
+            const char* first_;     //current line
+            const char* last_;
             size_t charCount_;          
             size_t lineCount_;          
 
             std::string ext_;   //the file name extension
+            const char* map_;   //memory-mapped file, if uncompressed
+            size_t mapSize_;
             bio::filtering_istreambuf in_; //chain of filters and input device
-            std::istreambuf_iterator<char> it_;
-            std::istreambuf_iterator<char> eos_;
+            boost::scoped_ptr<Inflater> inflater_;  //instead of in_
+            std::vector<char> chunk_;
+            const char* pos_;   //unread part of the mapping or chunk
+            const char* end_;
     };
 
 
-    inline Line_reader<char>::Line_reader(const std::string& fn) 
-        : file_(fn), charCount_(0), lineCount_(0)
+    inline Line_reader<char>::Line_reader(const std::string& fn,
+            size_t nthreads) 
+        : file_(fn), first_(0), last_(0), charCount_(0), lineCount_(0),
+        map_(0), mapSize_(0), chunk_(BUFFSIZE), pos_(0), end_(0)
     {
         using namespace detail;
 
-        buf_.resize(BUFFSIZE);
         ext_ =  (*file_).extension().string(); 
         if (ext_ ==  ".gz") {
-            in_.push(bio::gzip_decompressor()); 
             ext_ = file_.extension(1); //discard compression extension
             if (ext_.empty())
                 throw File_exception("not a regular file name.");
+            if (is_bgzf((*file_).string())) {
+                inflater_.reset(new Bgzf_inflater((*file_).string(), nthreads));
+            }
+            else if (nthreads > 1) {
+                inflater_.reset(new Gzip_pipe((*file_).string()));
+            }
+            if (inflater_) {
+                this->fill();
+                return;
+            }
+            in_.push(bio::gzip_decompressor()); 
+        }
+        else if (map_file((*file_).string())) {
+            return;
         }
 
         // the input streambuffer
@@ -194,47 +237,132 @@ namespace Permory { namespace io {
         if (not isOpen) {
             throw File_exception(fn + ": unable to open file.");
         }
+        this->fill();
+    }
+
+    inline Line_reader<char>::~Line_reader()
+    {
+#if !(defined(_WINDOWS) || defined(_WIN32) || defined(__WIN32__) || defined(_WIN64))
+        if (map_) {
+            ::munmap(const_cast<char*>(map_), mapSize_);
+        }
+#endif
+        inflater_.reset();
+        in_.reset(); //close all devices
+    }
+
+    //
+    // Map a regular, non-empty file into memory, else let the stream read it
+    inline bool Line_reader<char>::map_file(const std::string& fn)
+    {
+#if defined(_WINDOWS) || defined(_WIN32) || defined(__WIN32__) || defined(_WIN64)
+        return false;
+#else
+        int fd = ::open(fn.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        void* p = MAP_FAILED;
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            p = ::mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);    //the mapping stays valid
+        if (p == MAP_FAILED) {
+            return false;
+        }
+        ::madvise(p, st.st_size, MADV_SEQUENTIAL);
+        map_ = static_cast<const char*>(p);
+        mapSize_ = st.st_size;
+        pos_ = map_;
+        end_ = map_ + mapSize_;
+        return true;
+#endif
+    }
 
-        it_ = &in_;
-        std::istreambuf_iterator<char> eos;
-        eos_ = eos;
+    inline bool Line_reader<char>::fill()
+    {
+        if (map_) {
+            return false;
+        }
+        if (inflater_) {
+            const char* first;
+            const char* last;
+            while (inflater_->next(first, last)) {
+                if (first != last) {
+                    pos_ = first;
+                    end_ = last;
+                    return true;
+                }
+            }
+            pos_ = end_ = &chunk_[0];
+            return false;
+        }
+        std::streamsize n = in_.sgetn(&chunk_[0], chunk_.size());
+        pos_ = &chunk_[0];
+        end_ = pos_ + std::max(n, std::streamsize(0));
+        return n > 0;
     }
 
     inline void Line_reader<char>::next() 
     {
-        size_t nchar_ = 0;
-        std::vector<char>::iterator i = buf_.begin();
-        while (it_ != eos_ && *it_ != '\n') {
-            if (i == buf_.end()) {          //buffer full?
-                size_t sz = buf_.size();    //remember where we are
-                buf_.resize(buf_.size() + BUFFSIZE); //enlarge buffer
-                i = buf_.begin() + sz;      //read on from where we were
+        const char* nl = static_cast<const char*>(
+                std::memchr(pos_, '\n', end_ - pos_));
+        if (map_ && nl && size_t(end_ - nl) > line_padding) {
+            first_ = pos_;
+            last_ = nl;
+            pos_ = nl + 1;
+        }
+        else {
+            // The line is copied, as it may continue in the next chunk or be
+            // too close to the end of the mapping
+            buf_.clear();
+            while (true) {
+                const char* stop = nl ? nl : end_;
+                buf_.insert(buf_.end(), pos_, stop);
+                pos_ = stop;
+                if (nl) {
+                    ++pos_;
+                    break;
+                }
+                if (not this->fill()) {
+                    break;
+                }
+                nl = static_cast<const char*>(
+                        std::memchr(pos_, '\n', end_ - pos_));
             }
-            *i++ = *it_++;
-            nchar_++;
+            size_t n = buf_.size();
+            buf_.resize(n + line_padding, '\0');
+            first_ = &buf_[0];
+            last_ = first_ + n;
         }
-        buf_.resize(nchar_);    //chop off (possible) characters from last line
-        charCount_+= nchar_;
+        if (pos_ == end_) {
+            this->fill();   //so eof() is known
+        }
+        charCount_ += last_ - first_;
         lineCount_ ++;
 #if defined(_WINDOWS) || defined(_WIN32) || defined(__WIN32__) || defined(_WIN64)
-        if (!buf_.empty()) {
-            if (buf_.back() == '\r') //remove possible windows line ending artefact
-                buf_.pop_back();    
+        if (first_ != last_) {
+            if (*(last_ - 1) == '\r') //remove possible windows line ending artefact
+                --last_;
         }
 #endif
-        if (it_ != eos_) { 
-            it_++; //point to next line
-        }
     }
 
     inline void Line_reader<char>::skip() 
     {
-        while (it_ != eos_ && *it_ != '\n') {
-            it_++;
-        }
-
-        if (it_ != eos_) { 
-            it_++; //point to next line
+        while (pos_ != end_) {
+            const char* nl = static_cast<const char*>(
+                    std::memchr(pos_, '\n', end_ - pos_));
+            if (nl) {
+                pos_ = nl + 1;
+                if (pos_ == end_) {
+                    this->fill();
+                }
+                return;
+            }
+            pos_ = end_;
+            this->fill();
         }
     }
 
@@ -0,0 +1,237 @@
+// Copyright (c) 2026 The Permory contributors
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt.)
+
+#ifndef permory_io_plink_bed_hpp
+#define permory_io_plink_bed_hpp
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/utility.hpp>
+
+#include "detail/config.hpp"
+#include "detail/exception.hpp"
+#include "io/line_reader.hpp"
+
+namespace Permory { namespace io {
+
+    //
+    // File of the PLINK binary fileset (*.bed, *.bim, *.fam) that the file
+    // fn belongs to, e.g. ext=".bim"
+    //
+    inline std::string plink_fileset_file(const std::string& fn,
+            const std::string& ext)
+    {
+        return bfs::path(fn).replace_extension(ext).string();
+    }
+
+    //
+    // Whether the file starts with the magic bytes of a PLINK *.bed file
+    //
+    inline bool is_plink_bed(const std::string& fn)
+    {
+        std::ifstream ifs(fn.c_str(), std::ios::binary);
+        char magic[2];
+        return ifs.read(magic, 2) && magic[0] == 0x6c && magic[1] == 0x1b;
+    }
+
+    //
+    // Reads the genotypes of a PLINK binary fileset (*.bed), marker by
+    // marker (SNP-major) or at any marker. Each marker takes ceil(n/4) bytes
+    // for the n subjects of the *.fam file, 2 bits per subject starting
+    // with the low bits: 00 homozygous first allele, 01 missing, 10
+    // heterozygous, 11 homozygous second allele. The alleles are those of
+    // columns 5 and 6 of the *.bim file.
+    //
+    class Bed_reader : boost::noncopyable {
+        public:
+            // Ctor
+            explicit Bed_reader(const std::string& fn);
+
+            // Inspection
+            size_t nmarker() const { return alleles_.size()/2; }
+            size_t nsubject() const { return nsubject_; }
+            bool hasNext() const { return next_ < nmarker(); }
+            size_t tell() const { return next_; }  //marker read next
+
+            // Modification
+            void seek(size_t i);    //marker i is read next
+
+            // Conversion
+            // Next marker as 2 alleles per subject, each undef if missing
+            void next_alleles(std::vector<char>&, char undef);
+            // Next marker as the number ('0', '1', '2') of minor alleles per
+            // subject or '?' if missing, the same as the alleles condensed
+            // by Locus_data<char>::condense_alleles_to_genotypes
+            void next_genotypes(std::vector<char>&, char undef);
+
+        private:
+            void read();    //next marker into codes_
+
+            std::string fn_;
+            std::ifstream ifs_;
+            size_t nsubject_;
+            size_t nbytes_;             //per marker
+            size_t next_;               //next marker to read
+            std::vector<char> alleles_; //2 per marker
+            std::vector<char> table_;   //4 codes of each byte value
+            std::vector<char> bytes_;   //of the marker read last
+            std::vector<char> codes_;   //0..3 per subject, ditto
+    };
+
+    // ========================================================================
+    // Bed_reader implementation
+    inline Bed_reader::Bed_reader(const std::string& fn)
+        : fn_(fn), ifs_(fn.c_str(), std::ios::binary), nsubject_(0),
+        nbytes_(0), next_(0)
+    {
+        if (not ifs_) {
+            throw detail::File_exception(fn + ": unable to open file.");
+        }
+        char magic[3];
+        if (not ifs_.read(magic, 3) || magic[0] != 0x6c || magic[1] != 0x1b) {
+            throw detail::File_exception(fn + ": no PLINK *.bed file.");
+        }
+        if (magic[2] != 0x01) {
+            throw detail::File_exception(fn +
+                    ": individual-major *.bed files are not supported.");
+        }
+
+        Line_reader<std::string> fam(plink_fileset_file(fn, ".fam"));
+        std::string line;
+        while (not fam.eof()) {
+            fam.next_str(line);
+            if (not line.empty()) {
+                nsubject_++;
+            }
+        }
+        nbytes_ = (nsubject_ + 3)/4;
+
+        std::string bim = plink_fileset_file(fn, ".bim");
+        Line_reader<std::string> lr(bim);
+        while (not lr.eof()) {
+            lr.next_str(line);
+            if (line.empty()) {
+                continue;
+            }
+            std::istringstream iss(line);
+            std::string s[6];   //chr, rs, cM, bp, first and second allele
+            for (size_t i=0; i<6; ++i) {
+                iss >> s[i];
+            }
+            if (s[5].size() != 1 || s[4].size() != 1) {
+                throw detail::File_exception(bim +
+                        ": alleles must be single characters.");
+            }
+            alleles_.push_back(s[4][0]);
+            alleles_.push_back(s[5][0]);
+        }
+
+        ifs_.seekg(0, std::ios::end);
+        if (size_t(ifs_.tellg()) != 3 + nmarker()*nbytes_) {
+            throw detail::File_exception(fn_ +
+                    ": size does not fit the *.bim and *.fam files.");
+        }
+        table_.resize(4*256);
+        for (size_t b=0; b<256; ++b) {
+            for (size_t k=0; k<4; ++k) {
+                table_[4*b + k] = char((b >> 2*k) & 3);
+            }
+        }
+        seek(0);
+    }
+
+    inline void Bed_reader::seek(size_t i)
+    {
+        if (i > nmarker()) {
+            throw std::out_of_range("Bed_reader: no such marker.");
+        }
+        next_ = i;
+        ifs_.clear();
+        ifs_.seekg(std::streamoff(3 + i*nbytes_));
+    }
+
+    inline void Bed_reader::read()
+    {
+        if (not hasNext()) {
+            throw std::out_of_range("Bed_reader: no more markers.");
+        }
+        bytes_.resize(nbytes_);
+        if (nbytes_ > 0 && not ifs_.read(&bytes_[0], nbytes_)) {
+            throw detail::File_exception(fn_ + ": read error.");
+        }
+        next_++;
+
+        codes_.resize(4*nbytes_);
+        for (size_t j=0; j<nbytes_; ++j) {
+            const char* p = &table_[4*size_t((unsigned char) bytes_[j])];
+            std::copy(p, p + 4, &codes_[4*j]);
+        }
+        codes_.resize(nsubject_);   //drop the padding of the last byte
+    }
+
+    inline void Bed_reader::next_alleles(std::vector<char>& v, char undef)
+    {
+        read();
+        char a1 = alleles_[2*(next_ - 1)];
+        char a2 = alleles_[2*(next_ - 1) + 1];
+        const char pair[4][2] = {{a1, a1}, {undef, undef}, {a1, a2}, {a2, a2}};
+        v.resize(2*nsubject_);
+        for (size_t i=0; i<nsubject_; ++i) {
+            v[2*i] = pair[size_t(codes_[i])][0];
+            v[2*i + 1] = pair[size_t(codes_[i])][1];
+        }
+    }
+
+    inline void Bed_reader::next_genotypes(std::vector<char>& v, char undef)
+    {
+        read();
+        char a1 = alleles_[2*(next_ - 1)];
+        char a2 = alleles_[2*(next_ - 1) + 1];
+        size_t n[4] = {0, 0, 0, 0};
+        for (size_t i=0; i<nsubject_; ++i) {
+            n[size_t(codes_[i])]++;
+        }
+
+        // The minor allele as chosen by Locus_data<char>: least frequent
+        // defined allele, the smaller character on ties
+        const char pair[4][2] = {{a1, a1}, {undef, undef}, {a1, a2}, {a2, a2}};
+        std::map<char, size_t> count;
+        for (size_t c=0; c<4; ++c) {
+            for (size_t k=0; k<2; ++k) {
+                if (n[c] > 0 && pair[c][k] != undef) {
+                    count[pair[c][k]] += n[c];
+                }
+            }
+        }
+        char target = undef;
+        size_t least = 0;
+        for (std::map<char, size_t>::const_iterator it = count.begin();
+                it != count.end(); ++it) {
+            if (target == undef || it->second < least) {
+                target = it->first;
+                least = it->second;
+            }
+        }
+
+        char genotype[4];
+        for (size_t c=0; c<4; ++c) {
+            bool ok = pair[c][0] != undef && pair[c][1] != undef;
+            genotype[c] = ok ? char('0' + (pair[c][0] == target)
+                    + (pair[c][1] == target)) : '?';
+        }
+        v.resize(nsubject_);
+        for (size_t i=0; i<nsubject_; ++i) {
+            v[i] = genotype[size_t(codes_[i])];
+        }
+    }
+
+} // namespace io
+} // namespace Permory
+
+#endif // include guard
@@ -0,0 +1,167 @@
+// Copyright (c) 2026 The Permory contributors
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt.)
+
+#ifndef permory_io_tokenizer_hpp
+#define permory_io_tokenizer_hpp
+
+#include <string>
+
+#include "detail/config.hpp"
+#include "detail/popcount.hpp"  //PERMORY_X86_DISPATCH
+
+namespace Permory { namespace io {
+
+    //
+    // Delimiters of the marker data formats, e.g. " \t\r" (plink, presto)
+    // or " " (slide). Up to three different characters.
+    //
+    struct Delimiters {
+        Delimiters(char x, char y, char z) : a(x), b(y), c(z) { }
+        explicit Delimiters(char x=' ') : a(x), b(x), c(x) { }
+        bool operator()(char x) const { return x == a || x == b || x == c; }
+        char a;
+        char b;
+        char c;
+    };
+
+    //
+    // Position after the first n chunks of [first, last), where a chunk ends
+    // with a run of delimiters; the same as dropping characters while
+    // Skip_input_filter<n> (for " \t\r") says so
+    //
+    inline const char* skip_chunks(const char* first, const char* last,
+            size_t n, const Delimiters& d)
+    {
+        size_t cnt = 0;
+        bool isDelim = false;
+        for (; first != last && cnt < n; ++first) {
+            if (d(*first)) {
+                cnt += not isDelim;
+                isDelim = true;
+            }
+            else {
+                isDelim = false;
+            }
+        }
+        return first;
+    }
+
+    //
+    // Copy the next chunk of [first, last), without the delimiters before
+    // and after it, into s and return the position after it
+    //
+    inline const char* next_chunk(const char* first, const char* last,
+            const Delimiters& d, std::string& s)
+    {
+        while (first != last && d(*first)) {
+            ++first;
+        }
+        const char* end = first;
+        while (end != last && not d(*end)) {
+            ++end;
+        }
+        s.assign(first, end);
+        return end;
+    }
+
+    //
+    // Kernels copying all characters of [first, last) that are no delimiters
+    // to out, which must have room for last - first characters; they do not
+    // write beyond. Return the end of the copied characters.
+    //
+    typedef char* (*remove_delimiters_fn)(const char*, const char*, char*,
+            const Delimiters&);
+
+    inline char* remove_delimiters_generic(const char* first, const char* last,
+            char* out, const Delimiters& d)
+    {
+        for (; first != last; ++first) {
+            *out = *first;
+            out += not d(*first);
+        }
+        return out;
+    }
+
+#ifdef PERMORY_X86_DISPATCH
+    //
+    // For each byte mask of characters to keep: the shuffle moving them to
+    // the front and their number
+    //
+    struct Compress_table {
+        Compress_table() {
+            for (size_t m=0; m<256; ++m) {
+                size_t k = 0;
+                for (size_t i=0; i<8; ++i) {
+                    if (m & (size_t(1) << i)) {
+                        shuffle[m][k++] = char(i);
+                    }
+                }
+                count[m] = (unsigned char) k;
+                for (; k<8; ++k) {
+                    shuffle[m][k] = char(0x80);     //zero
+                }
+            }
+        }
+        char shuffle[256][8];
+        unsigned char count[256];
+    };
+
+    // 16 characters at a time: delimiters are found by comparison, and the
+    // others of each half are packed by a byte shuffle (pshufb)
+    __attribute__((target("ssse3"))) inline char* remove_delimiters_ssse3(
+            const char* first, const char* last, char* out,
+            const Delimiters& d)
+    {
+        static const Compress_table table;
+        const __m128i da = _mm_set1_epi8(d.a);
+        const __m128i db = _mm_set1_epi8(d.b);
+        const __m128i dc = _mm_set1_epi8(d.c);
+        for (; last - first >= 16; first += 16) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+            __m128i isDelim = _mm_or_si128(_mm_cmpeq_epi8(x, da),
+                    _mm_or_si128(_mm_cmpeq_epi8(x, db), _mm_cmpeq_epi8(x, dc)));
+            unsigned keep = ~unsigned(_mm_movemask_epi8(isDelim)) & 0xffff;
+            if (keep == 0xffff) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out), x);
+                out += 16;
+                continue;
+            }
+            unsigned lo = keep & 0xff;
+            unsigned hi = keep >> 8;
+            __m128i packed = _mm_shuffle_epi8(x, _mm_loadl_epi64(
+                        reinterpret_cast<const __m128i*>(table.shuffle[lo])));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out), packed);
+            out += table.count[lo];
+            packed = _mm_shuffle_epi8(_mm_srli_si128(x, 8), _mm_loadl_epi64(
+                        reinterpret_cast<const __m128i*>(table.shuffle[hi])));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out), packed);
+            out += table.count[hi];
+        }
+        return remove_delimiters_generic(first, last, out, d);
+    }
+#endif // PERMORY_X86_DISPATCH
+
+    inline remove_delimiters_fn fastest_remove_delimiters_kernel()
+    {
+#ifdef PERMORY_X86_DISPATCH
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("ssse3")) {
+            return &remove_delimiters_ssse3;
+        }
+#endif
+        return &remove_delimiters_generic;
+    }
+
+    // The kernel to use, determined once
+    inline char* remove_delimiters(const char* first, const char* last,
+            char* out, const Delimiters& d)
+    {
+        static const remove_delimiters_fn k = fastest_remove_delimiters_kernel();
+        return k(first, last, out, d);
+    }
+
+} // namespace io
+} // namespace Permory
+
+#endif // include guard
@@ -8,6 +8,8 @@
 
 #include <set>
 #include <deque>
+#include <sstream>
+#include <string>
 #include <vector>
 
 //#include <boost/progress.hpp>
@@ -19,6 +21,7 @@
 #include <boost/mpi/collectives.hpp>
 #include <boost/serialization/deque.hpp>
 #include <boost/progress.hpp>   //timer
+#include <boost/thread/thread.hpp>
 
 #include <boost/mpi/operations.hpp>
 
@@ -27,19 +30,64 @@
 #include "detail/functors.hpp"
 #include "gwas/gwas.hpp"
 #include "gwas/analysis.hpp"
+#include "gwas/marker_source.hpp"
+#include "gwas/packed_locus_store.hpp"
 #include "io/output.hpp"
+#include "statistical/exceedance.hpp"
 
-// Make deque_concat() commutative to gain more speed.
+// Make Exceedance_merge() commutative to gain more speed.
 namespace boost { namespace mpi {
 
   template<>
-  struct is_commutative<Permory::detail::deque_concat<double>, std::deque<double> >
+  struct is_commutative<Permory::statistic::Exceedance_merge,
+         Permory::statistic::Exceedance_counts>
     : mpl::true_ { };
 } } // end namespace boost::mpi
 
 namespace Permory { namespace gwas {
     namespace mpi = boost::mpi;
 
+    //
+    // Marker data read and parsed by the first process only, which sends
+    // them to all others in chunks of packed loci (see Packed_locus_store),
+    // so the files are read once instead of once per process. All processes
+    // must take all markers, as each chunk is a collective broadcast. The
+    // broadcasts stay on the main thread (MPI_THREAD_FUNNELED), while the
+    // first process reads the files ahead with a thread of their own.
+    //
+    class Broadcast_marker_source : public Marker_source {
+        public:
+            // Ctor
+            Broadcast_marker_source(
+                    const mpi::communicator& world,
+                    const detail::Parameter& par,
+                    size_t prefetch,    //markers read ahead (first process)
+                    size_t chunk_bytes=size_t(1) << 24) //packed data per chunk
+                : world_(world), pos_(0), chunkBytes_(chunk_bytes)
+            {
+                if (world_.rank() == 0) {
+                    files_.reset(new Prefetching_marker_source(
+                                new File_marker_source(par.fn_marker_data,
+                                    par.undef_allele_code, par.nthreads,
+                                    par.marker_type, par.marker_data_format),
+                                prefetch));
+                }
+            }
+
+            // Conversion
+            Locus_data<char>* next();
+
+        private:
+            void next_chunk();
+
+            const mpi::communicator& world_;
+            boost::scoped_ptr<Marker_source> files_; //first process only
+            Packed_locus_store chunk_;
+            std::vector<char> scratch_; //decoded data of a marker
+            size_t pos_;        //next marker in chunk_
+            size_t chunkBytes_;
+    };
+
     class Mpi_analyzer : public Analyzer {
         public:
             // Ctor
@@ -49,19 +97,49 @@ namespace Permory { namespace gwas {
                     detail::Parameter* par, io::Myout& out, Gwas* study,
                     std::set<char> the_domain=std::set<char>())
                 : Analyzer(par, out, study, the_domain),
-                  env_(env), world_(world)
+                  env_(env), world_(world), blockSize_(0), nblocks_(0),
+                  nextBlock_(world->size()), nworking_(world->size() - 1),
+                  hasStarted_(false), isDone_(false)
             {
-                // memorize old nperm_total and set per process nperm_total
+                // memorize old nperm_total and set per process nperm_total,
+                // which with dynamic scheduling is just an upper bound
                 orig_nperm_total_ = par_->nperm_total;
-                par_->nperm_total = nperm_per_process();
+                if (not par_->mpiDynamic) {
+                    par_->nperm_total = nperm_per_process();
+                }
 
-                // different seed for all processes
-                par_->seed += world_->rank();
+                if (par_->usePhilox) {
+                    // each process takes its own range of permutations, so
+                    // results do not depend on the number of processes
+                    firstPerm_ = first_perm_of_process();
+                }
+                else {
+                    // different seed for all processes
+                    par_->seed += world_->rank();
+                }
 
                 if (world_->rank() > 0) {
                     par_->quiet = true;
                     par_->verbose = false;
                 }
+
+                if (orig_nperm_total_ < size_t(world_->size())) {
+                    throw std::invalid_argument(
+                            "Fewer permutations than MPI processes.");
+                }
+
+                // Each process may run a team of threads sharing its
+                // permutations and marker data
+                if (par_->nthreads > 1 &&
+                        mpi::environment::thread_level() < mpi::threading::funneled) {
+                    throw std::runtime_error(
+                            "The MPI library does not support --threads.");
+                }
+                if (world_->rank() == 0) {
+                    out_ << detail::normal << io::stdpre << world_->size()
+                        << " MPI processes with " << par_->nthreads
+                        << " thread(s) each." << std::endl;
+                }
             }
 
             // Dtor
@@ -69,14 +147,33 @@ namespace Permory { namespace gwas {
 
         protected:
             size_t nperm_per_process() const;
+            size_t first_perm_of_process() const;
 
-            virtual void output_results(const std::deque<double>& tperm);
+            virtual void output_results(const statistic::Exceedance_counts&);
+            virtual Marker_source* marker_source();
+            virtual size_t prefetch() const;
+            virtual size_t next_block(size_t perm_todo,
+                    permutation::Permutation&);
+            virtual void poll();
+            virtual std::string checkpoint_file() const;
 
         private:
+            enum Tag { tag_request = 1, tag_block, tag_done };
+            void serve(bool wait);
+
             boost::shared_ptr<mpi::environment> env_;
             boost::shared_ptr<mpi::communicator> world_;
 
             size_t orig_nperm_total_;
+
+            // Dynamic scheduling (--mpi-dynamic): the permutations are split
+            // into numbered blocks, which the first process hands out
+            unsigned long blockSize_;
+            unsigned long nblocks_;
+            unsigned long nextBlock_;   //first process: next to hand out
+            int nworking_;              //first process: others not yet done
+            bool hasStarted_;
+            bool isDone_;               //others: got no more blocks
     };
 
     class Mpi_analyzer_factory : public Abstract_analyzer_factory {
@@ -88,7 +185,9 @@ namespace Permory { namespace gwas {
             // Modifiers
             static void init_mpi(int *argc, char ***argv)
             {
-                env_ = boost::shared_ptr<mpi::environment>(new mpi::environment(*argc, *argv));
+                // Threads of a process (--threads) do no MPI calls
+                env_ = boost::shared_ptr<mpi::environment>(new mpi::environment(
+                            *argc, *argv, mpi::threading::funneled));
                 world_ = boost::shared_ptr<mpi::communicator>(new mpi::communicator());
             }
 
@@ -107,6 +206,35 @@ namespace Permory { namespace gwas {
     boost::shared_ptr<mpi::environment> Mpi_analyzer_factory::env_;
     boost::shared_ptr<mpi::communicator> Mpi_analyzer_factory::world_;
 
+    // Broadcast_marker_source implementation
+    // ========================================================================
+    inline Locus_data<char>* Broadcast_marker_source::next()
+    {
+        if (pos_ == chunk_.size()) {
+            next_chunk();
+            if (chunk_.empty()) {   //the end, known to all processes
+                return 0;
+            }
+        }
+        return chunk_.get(pos_++, scratch_);
+    }
+
+    inline void Broadcast_marker_source::next_chunk()
+    {
+        chunk_.clear();
+        pos_ = 0;
+        if (world_.rank() == 0) {
+            while (chunk_.nbytes() < chunkBytes_) {
+                boost::scoped_ptr<Locus_data<char> > p(files_->next());
+                if (not p) {
+                    break;
+                }
+                chunk_.add(*p);
+            }
+        }
+        mpi::broadcast(world_, chunk_, 0);
+    }
+
     // Analyzer implementation
     // ========================================================================
 
@@ -118,28 +246,156 @@ namespace Permory { namespace gwas {
                      : per_process;
     }
 
+    //
+    // With --in-memory, the markers are broadcast by the first process in
+    // the first round only and kept packed by all processes, whose rounds
+    // may then differ in number (--precision, uneven shares of
+    // permutations). Otherwise each process reads the files in each round,
+    // so none keeps all markers.
+    Marker_source* Mpi_analyzer::marker_source()
+    {
+        if (par_->inMemory) {
+            return new Broadcast_marker_source(*world_, *par_,
+                    Analyzer::prefetch());
+        }
+        return Analyzer::marker_source();
+    }
+
+    //
+    // Broadcast markers are read ahead by the first process only, see
+    // Broadcast_marker_source
+    size_t Mpi_analyzer::prefetch() const
+    {
+        return par_->inMemory ? 0 : Analyzer::prefetch();
+    }
+
+    //
+    // With dynamic scheduling, block i holds the counter-based permutations
+    // i*blockSize_, ... Each process starts with the block of its rank, as
+    // all of them take part in the first round (with --in-memory, see
+    // Broadcast_marker_source), and then asks the first process for the next free block until there
+    // are none left. Blocks are at most N/nprocesses permutations, so there
+    // is one for everybody.
+    size_t Mpi_analyzer::next_block(size_t perm_todo,
+            permutation::Permutation& pp)
+    {
+        if (not par_->mpiDynamic) {
+            return Analyzer::next_block(perm_todo, pp);
+        }
+        unsigned long block;
+        if (not hasStarted_) {
+            hasStarted_ = true;
+            blockSize_ = std::min(par_->nperm_block,
+                    orig_nperm_total_/world_->size());
+            nblocks_ = (orig_nperm_total_ + blockSize_ - 1)/blockSize_;
+            block = world_->rank();
+        }
+        else if (world_->rank() == 0) {
+            this->serve(false);
+            block = nextBlock_ < nblocks_ ? nextBlock_++ : nblocks_;
+        }
+        else {
+            world_->send(0, tag_request);
+            world_->recv(0, tag_block, block);
+            isDone_ = block >= nblocks_;
+        }
+        if (block >= nblocks_) {
+            return 0;
+        }
+        pp.set_next_index(block*blockSize_);
+        return std::min(blockSize_, orig_nperm_total_ - block*blockSize_);
+    }
+
+    void Mpi_analyzer::poll()
+    {
+        if (par_->mpiDynamic && hasStarted_ && world_->rank() == 0) {
+            this->serve(false);
+        }
+    }
+
+    //
+    // First process: answer the requests for blocks of the others, and,
+    // if wait is true, until all of them are done
+    void Mpi_analyzer::serve(bool wait)
+    {
+        using boost::optional;
+        while (nworking_ > 0) {
+            optional<mpi::status> s = world_->iprobe(mpi::any_source, tag_done);
+            if (s) {    //stopped early (--precision)
+                world_->recv(s->source(), tag_done);
+                nworking_--;
+                continue;
+            }
+            s = world_->iprobe(mpi::any_source, tag_request);
+            if (not s) {
+                if (not wait) {
+                    return;
+                }
+                // Not a blocking probe for any tag, which might catch
+                // messages of the reduction of those already done
+                boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+                continue;
+            }
+            world_->recv(s->source(), tag_request);
+            unsigned long block = nextBlock_ < nblocks_ ? nextBlock_++ : nblocks_;
+            world_->send(s->source(), tag_block, block);
+            if (block >= nblocks_) {
+                nworking_--;
+            }
+        }
+    }
+
+    //
+    // Each process saves its own state
+    std::string Mpi_analyzer::checkpoint_file() const
+    {
+        std::ostringstream oss;
+        oss << Analyzer::checkpoint_file() << "." << world_->rank();
+        return oss.str();
+    }
+
+    // Ranks are assigned consecutive ranges of permutations, rank 0 the first
+    size_t Mpi_analyzer::first_perm_of_process() const
+    {
+        size_t per_process = orig_nperm_total_ / world_->size();
+        size_t first_process = orig_nperm_total_ - per_process*(world_->size() - 1);
+        return world_->rank() == 0 ? 0
+            : first_process + per_process*size_t(world_->rank() - 1);
+    }
+
     //
     //  Compute adjusted p-values and output results
     void Mpi_analyzer::output_results(
-            const std::deque<double>& tperm //*sorted* max test statistic per permutation
+            const statistic::Exceedance_counts& exceed //of this process
             )
     {
         using namespace std;
         using namespace boost::mpi;
-        using namespace detail;
+        using namespace statistic;
+
+        if (par_->mpiDynamic) {
+            if (world_->rank() == 0) {
+                this->serve(true);
+            }
+            else if (not isDone_) {
+                world_->send(0, tag_done);
+            }
+        }
 
         if (world_->rank() == 0) {
             boost::timer t;
-            deque<double> tperm_result;
-            reduce(*world_, tperm, tperm_result, deque_concat<double>(), 0);
+            Exceedance_counts result;
+            reduce(*world_, exceed, result, Exceedance_merge(), 0);
             out_ << all << io::stdpre << "Runtime reduce: " << t.elapsed() << " s" << endl;
             t.restart();
-            par_->nperm_total = orig_nperm_total_;  // reset nperm_total for correct output calculations
-            Analyzer::output_results(tperm_result);
+            // reset nperm_total for correct output calculations; processes
+            // may have stopped early (--precision)
+            par_->nperm_total = result.nperm();
+            Analyzer::output_results(result);
             out_ << all << io::stdpre << "Runtime output: " << t.elapsed() << " s" << endl;
         }
         else {
-            reduce(*world_, tperm, deque_concat<double>(), 0);
+            reduce(*world_, exceed, Exceedance_merge(), 0);
         }
     }
 
@@ -80,6 +80,10 @@ namespace Permory {
         perm.add_options()
             ("nperm,n", my_value<size_t>("NUM")->my_default_value(10000),
              "Number of permutations")
+            ("rng", my_value<string>("NAME")->my_default_value("mt19937"),
+             "random number generator: 'mt19937' or 'philox' (counter-based, "
+             "results do not depend on --block, --threads or the number of "
+             "MPI processes)")
             ("seed", my_value<int>("NUM")->my_default_value(12345678), 
              "random seed")
             ;
@@ -94,12 +98,45 @@ namespace Permory {
              "genome-wide significance threshold determining the effective number of tests")
             ("block",my_value<size_t>("NUM")->my_default_value(10000),  
              "permutation block size")
+            ("calibrate", "time the permutation methods at startup to choose "
+             "the fastest per marker")
+            ("checkpoint", my_value<double>("MIN")->my_default_value(0, ""),
+             "save the state of the permutations to <out-prefix>.checkpoint "
+             "after a block, at most every MIN minutes (see --resume)")
+            ("compact", "keep permutations of a dichotomous trait bit-packed "
+             "only, which needs 8-16 times less memory")
+            ("cost-model", my_value<string>("FILE")->my_default_value("", ""),
+             "read costs of the permutation methods from FILE, or write them "
+             "to FILE with '--calibrate'")
             ("counts", "in addition to p-values, output #(T_perm > T_orig)")
             ("debug,d", "most detailed output")
+            ("gpd", "for markers exceeded by less than 10 permutations, "
+             "extrapolate the adjusted p-value and its 95% confidence "
+             "interval from a generalized Pareto fit to the tail of the "
+             "permutation distribution")
+            ("in-memory", "keep marker data in memory between permutation blocks")
+            ("mem-limit", my_value<size_t>("MB")->my_default_value(0, ""),
+             "choose the largest permutation block size (at most --block, if "
+             "given) whose data fit into MB megabytes")
+            ("mpi-dynamic", "with MPI, processes take permutation blocks one "
+             "at a time from the first process, so faster ones do more "
+             "(requires '--rng philox')")
             ("ntop", my_value<size_t>("NUM")->my_default_value(100), 
              "number of top markers listed in *.top output file")
+            ("precision", my_value<double>("NUM")->my_default_value(0, ""),
+             "stop permuting once the 99% confidence interval of the adjusted "
+             "p-value of each top marker (see --ntop) is narrower than "
+             "NUM*alpha")
+            ("prefetch", my_value<size_t>("NUM")->my_default_value(64),
+             "number of markers read, parsed and checked ahead of their "
+             "analysis by a thread of its own (0: no such thread)")
+            ("resume", "continue the run at its last checkpoint (see "
+             "--checkpoint), if there is one")
+            ("split-perm", "threads split the permutations instead of the markers")
             ("tail", my_value<size_t>("NUM")->my_default_value(100), 
              "size of sliding tail (REM method)")
+            ("threads", my_value<size_t>("NUM")->my_default_value(1), 
+             "number of threads sharing the permutations")
             ;
 
         // Hidden options, will be allowed both on command line and
@@ -241,6 +278,36 @@ namespace Permory {
         if (vm["alpha"].as<double>() <= 0 || vm["alpha"].as<double>() > 1) {
             throw invalid_argument("significance threshold --alpha must be in [0,1].");
         }
+        if (vm["precision"].as<double>() < 0) {
+            throw invalid_argument("--precision must not be < 0");
+        }
+        if (vm["checkpoint"].as<double>() < 0) {
+            throw invalid_argument("--checkpoint must not be < 0");
+        }
+        if (vm["threads"].as<size_t>() == 0) {
+            throw invalid_argument("number of --threads must not be 0");
+        }
+        string rng = vm["rng"].as<string>();
+        if (rng != "mt19937" && rng != "philox") {
+            throw invalid_argument("--rng must be 'mt19937' or 'philox'");
+        }
+        if (vm.count("mpi-dynamic") > 0 && rng != "philox") {
+            throw invalid_argument("--mpi-dynamic requires --rng philox");
+        }
+        bool hasCheckpoint = vm["checkpoint"].as<double>() > 0
+            || vm.count("resume") > 0;
+        if (vm.count("mpi-dynamic") > 0 && hasCheckpoint) {
+            throw invalid_argument("--mpi-dynamic cannot be combined with "
+                    "--checkpoint or --resume");
+        }
+        bool hasCostModel = not vm["cost-model"].defaulted();
+        if (hasCostModel && vm.count("calibrate") == 0) {
+            string fn = vm["cost-model"].as<string>();
+            ifstream ifs(fn.c_str());
+            if (!ifs) {
+                throw runtime_error("Unable to open cost model file: " + fn);
+            }
+        }
 
         // Obsolete options
         if (hasTraitFile && hasNca) {
@@ -304,6 +371,7 @@ namespace Permory {
         // Permutation
         par.nperm_total = vm["nperm"].as<size_t>();
         par.seed = vm["seed"].as<int>();
+        par.usePhilox = vm["rng"].as<string>() == "philox";
 
         // Advanced
         par.alpha = vm["alpha"].as<double>();
@@ -312,6 +380,22 @@ namespace Permory {
         par.debug = vm.count("debug") > 0;
         par.ntop = vm["ntop"].as<size_t>();
         par.tail_size = vm["tail"].as<size_t>();
+        par.nthreads = vm["threads"].as<size_t>();
+        par.precision = vm["precision"].as<double>();
+        par.gpdTail = vm.count("gpd") > 0;
+        par.checkpoint = vm["checkpoint"].as<double>();
+        par.resume = vm.count("resume") > 0;
+        par.splitPerm = vm.count("split-perm") > 0;
+        par.inMemory = vm.count("in-memory") > 0;
+        par.prefetch = vm["prefetch"].as<size_t>();
+        par.compactPerm = vm.count("compact") > 0;
+        par.mem_limit = vm["mem-limit"].as<size_t>()*(size_t(1) << 20);
+        par.mpiDynamic = vm.count("mpi-dynamic") > 0;
+        if (par.mem_limit > 0 && vm["block"].defaulted()) {
+            par.nperm_block = par.nperm_total;  //limited by memory only
+        }
+        par.calibrate = vm.count("calibrate") > 0;
+        par.fn_cost_model = vm["cost-model"].as<string>();
     }
 }   //namespace Permory
 
@@ -6,21 +6,26 @@
 #ifndef permory_permutation_boost_algorithms_hpp
 #define permory_permutation_boost_algorithms_hpp
 
+#include <algorithm>
 #include <valarray>
 #include <vector>
 
 #include <boost/dynamic_bitset.hpp>
+#include <boost/type_traits/integral_constant.hpp>
+#include <boost/type_traits/is_integral.hpp>
 
 #include "detail/config.hpp"
+#include "detail/popcount.hpp"
 #include "perm_matrix.hpp"
+#include "recode.hpp"
 
 namespace Permory { namespace permutation {
     typedef boost::dynamic_bitset<> bitset_t;
 
-    // The following three functions (bar, git, and rem) are the core elements 
+    // The following functions (bar, git, bsl, and rem) are the core elements 
     // to accelerate the overall permutation process. For each data vector, 
     // which basically is the genotype data corresponding to some marker, and for 
-    // each genotype (e.g. 0,1,2) of this vector, that of the three methods is 
+    // each genotype (e.g. 0,1,2) of this vector, that of the methods is 
     // chosen at runtime, which for each permutation can determine the
     // corresponding genotype frequencies the fastest.
     // For more details, we refer to the publication:
@@ -32,14 +37,349 @@ namespace Permory { namespace permutation {
     //
     template<class T> inline void bar(   
             const Perm_matrix<T>& pmat, //matrix of predefined permutations
-            const bitset_t& b,          //bitset aka dummy coded data
+            const detail::word_t* w,    //dummy-coded data padded like a row
             std::valarray<T>& res)      //results are written into res
     {
-        assert (b.size() == pmat.bitMat_.front().size());
-        assert (res.size() == pmat.bitMat_.size());
+        using namespace Permory::detail;
+        assert (res.size() == pmat.bitMat_.nrow());
+        and_count_fn and_count = and_count_kernel().second;
+        size_t n = pmat.bitMat_.nwords();
         for (size_t i=0; i<res.size(); i++) {
-            res[i] = (b & pmat.bitMat_[i]).count();
+            res[i] = and_count(w, pmat.bitMat_[i], n);
+        }
+    }
+    template<class T> inline void bar(   
+            const Perm_matrix<T>& pmat, //matrix of predefined permutations
+            const bitset_t& b,          //bitset aka dummy coded data
+            std::valarray<T>& res)      //results are written into res
+    {
+        assert (b.size() == pmat.bitMat_.ncol());
+        std::vector<detail::word_t> w;
+        pmat.bitMat_.to_words(b, w);
+        bar(pmat, &w[0], res);
+    }
+
+    namespace git_detail {
+        // Columns processed per pass, such that the part of the result being
+        // updated stays in the L1 cache
+        const size_t chunk_bytes = 8192;
+
+        //
+        // res[c] (+/-)= sum of rows idx[0], ..., idx[n-1] of m. Integral
+        // counts are summed up four rows at a time (register blocking), which
+        // changes the order of additions. Therefore other types (e.g. sums of
+        // quantitative traits) are added one row after the other just like
+        // valarray::operator+= does, so results do not differ in rounding.
+        //
+        template<class T, bool isSub> inline void update_rows(
+                const detail::Aligned_matrix<T>& m,
+                const int* idx, size_t n,
+                T* res,
+                boost::true_type)   //T is integral
+        {
+            const size_t chunk = std::max(size_t(1), chunk_bytes/sizeof(T));
+            size_t ncol = m.ncol();
+            for (size_t c0=0; c0<ncol; c0+=chunk) {
+                size_t c1 = std::min(c0 + chunk, ncol);
+                size_t i = 0;
+                for (; i+4<=n; i+=4) {
+                    const T* r0 = m[idx[i]];
+                    const T* r1 = m[idx[i + 1]];
+                    const T* r2 = m[idx[i + 2]];
+                    const T* r3 = m[idx[i + 3]];
+                    for (size_t c=c0; c<c1; ++c) {
+                        T sum = T(T(r0[c] + r1[c]) + T(r2[c] + r3[c]));
+                        res[c] = isSub ? T(res[c] - sum) : T(res[c] + sum);
+                    }
+                }
+                for (; i<n; ++i) {
+                    const T* r = m[idx[i]];
+                    for (size_t c=c0; c<c1; ++c) {
+                        res[c] = isSub ? T(res[c] - r[c]) : T(res[c] + r[c]);
+                    }
+                }
+            }
+        }
+        template<class T, bool isSub> inline void update_rows(
+                const detail::Aligned_matrix<T>& m,
+                const int* idx, size_t n,
+                T* res,
+                boost::false_type)  //T is not integral
+        {
+            const size_t chunk = std::max(size_t(1), chunk_bytes/sizeof(T));
+            size_t ncol = m.ncol();
+            for (size_t c0=0; c0<ncol; c0+=chunk) {
+                size_t c1 = std::min(c0 + chunk, ncol);
+                for (size_t i=0; i<n; ++i) {
+                    const T* r = m[idx[i]];
+                    for (size_t c=c0; c<c1; ++c) {
+                        if (isSub) {
+                            res[c] -= r[c];
+                        }
+                        else {
+                            res[c] += r[c];
+                        }
+                    }
+                }
+            }
+        }
+
+        template<class T> inline void add_rows(
+                const detail::Aligned_matrix<T>& m,
+                const std::vector<int>& idx,
+                std::valarray<T>& res)
+        {
+            if (not idx.empty()) {
+                update_rows<T, false>(m, &idx[0], idx.size(), &res[0],
+                        boost::is_integral<T>());
+            }
+        }
+        template<class T> inline void subtract_rows(
+                const detail::Aligned_matrix<T>& m,
+                const std::vector<int>& idx,
+                std::valarray<T>& res)
+        {
+            if (not idx.empty()) {
+                update_rows<T, true>(m, &idx[0], idx.size(), &res[0],
+                        boost::is_integral<T>());
+            }
+        }
+    } // namespace git_detail
+
+    namespace bsl_detail {
+        using Permory::detail::word_t;
+        using Permory::detail::words_per_line;
+
+        // Carry-save adder on a cache line of words: (h,l) = a + b + c
+        inline void csa(word_t* h, word_t* l,
+                const word_t* a, const word_t* b, const word_t* c)
+        {
+            for (size_t i=0; i<words_per_line; ++i) {
+                word_t u = a[i] ^ b[i];
+                word_t hi = (a[i] & b[i]) | (u & c[i]);
+                l[i] = u ^ c[i];
+                h[i] = hi;
+            }
+        }
+
+        //
+        // res[j] (+/-)= bit j of the n bits of w shifted left by shift, that
+        // is, the bits are expanded to one T each, which with AVX2 is done
+        // for many of them at once
+        //
+        template<class T, bool isSub>
+#ifdef PERMORY_X86_DISPATCH
+            __attribute__((always_inline))  //see expand_bits_avx2
+#endif
+            inline void expand_bits_generic(
+                    const word_t* w, size_t n, unsigned shift, T* res)
+        {
+            const size_t bits = 8*sizeof(word_t);
+            for (size_t k=0; k*bits<n; ++k) {
+                word_t x = w[k];
+                T* r = res + k*bits;
+                if (n - k*bits >= bits) {   //constant trip count vectorizes
+                    for (size_t j=0; j<bits; ++j) {
+                        T t = T(((x >> j) & 1) << shift);
+                        if (isSub) {
+                            r[j] -= t;
+                        }
+                        else {
+                            r[j] += t;
+                        }
+                    }
+                    continue;
+                }
+                for (size_t j=0; j<n - k*bits; ++j) {
+                    T t = T(((x >> j) & 1) << shift);
+                    if (isSub) {
+                        r[j] -= t;
+                    }
+                    else {
+                        r[j] += t;
+                    }
+                }
+            }
+        }
+
+#ifdef PERMORY_X86_DISPATCH
+        // The generic kernel, which is always inlined and thus vectorized by
+        // the compiler for AVX2 here
+        template<class T, bool isSub> __attribute__((target("avx2")))
+            inline void expand_bits_avx2(
+                    const word_t* w, size_t n, unsigned shift, T* res)
+        {
+            expand_bits_generic<T, isSub>(w, n, shift, res);
+        }
+#endif // PERMORY_X86_DISPATCH
+
+        inline bool has_avx2()
+        {
+#ifdef PERMORY_X86_DISPATCH
+            static const bool yes = (__builtin_cpu_init(),
+                    __builtin_cpu_supports("avx2"));
+            return yes;
+#else
+            return false;
+#endif
+        }
+
+        template<class T> inline void expand_bits(
+                const word_t* w, size_t n, unsigned shift, T* res, bool isSub)
+        {
+#ifdef PERMORY_X86_DISPATCH
+            if (has_avx2()) {
+                if (isSub) {
+                    expand_bits_avx2<T, true>(w, n, shift, res);
+                }
+                else {
+                    expand_bits_avx2<T, false>(w, n, shift, res);
+                }
+                return;
+            }
+#endif
+            if (isSub) {
+                expand_bits_generic<T, true>(w, n, shift, res);
+            }
+            else {
+                expand_bits_generic<T, false>(w, n, shift, res);
+            }
+        }
+
+        // Up to this many indices, expanding their rows is faster than
+        // adding them up with carry-save adders
+        const size_t max_expand = 6;
+
+        enum Mode { assign, add, subtract };   //what to do with the counts
+
+        //
+        // Each word of the bit-sliced matrix holds one subject in as many
+        // permutations as the word has bits. Adding up the words of the
+        // indexed subjects with "vertical" counters, whose bit planes are
+        // words as well, counts all of these permutations at once. The words
+        // are processed in chunks of a cache line, and 16 subjects at a time
+        // are added with a tree of carry-save adders (Harley-Seal) to avoid
+        // branching.
+        //
+        template<class T> inline void count(
+                const detail::Bit_matrix& m,
+                const std::vector<int>& idx,
+                std::valarray<T>& res,
+                std::vector<word_t>& buf,
+                Mode mode)
+        {
+            using namespace Permory::detail;
+            assert (res.size() == m.ncol());
+            if (idx.size() <= max_expand) {
+                if (mode == assign) {
+                    res = T(0);
+                }
+                BOOST_FOREACH(int i, idx) {
+                    expand_bits(m[i], res.size(), 0, &res[0], mode == subtract);
+                }
+                return;
+            }
+            const size_t bits = 8*sizeof(word_t);
+            const size_t lanes = words_per_line;
+
+            // Planes counting the multiples of 16, enough for idx.size()/16
+            size_t nplane = 1;
+            while ((size_t(1) << nplane) <= idx.size()/16) {
+                nplane++;
+            }
+            buf.resize((9 + nplane)*lanes);
+            word_t* ones = &buf[0];
+            word_t* twos = ones + lanes;
+            word_t* fours = twos + lanes;
+            word_t* eights = fours + lanes;
+            word_t* twosA = eights + lanes;
+            word_t* twosB = twosA + lanes;
+            word_t* foursA = twosB + lanes;
+            word_t* foursB = foursA + lanes;
+            word_t* eightsA = foursB + lanes;
+            word_t* planes = eightsA + lanes;   //planes[b*lanes + lane]
+            word_t sixteens[words_per_line];
+            word_t eightsB[words_per_line];
+            const word_t zero[words_per_line] = {0};
+
+            for (size_t k=0; k<m.nwords(); k+=lanes) {
+                std::fill(buf.begin(), buf.end(), word_t(0));
+                for (size_t i=0; i<idx.size(); i+=16) {
+                    // The 16 summands, padded with zeros at the end
+                    const word_t* d[16];
+                    for (size_t j=0; j<16; ++j) {
+                        d[j] = i + j < idx.size() ? m[idx[i + j]] + k : zero;
+                    }
+                    csa(twosA, ones, ones, d[0], d[1]);
+                    csa(twosB, ones, ones, d[2], d[3]);
+                    csa(foursA, twos, twos, twosA, twosB);
+                    csa(twosA, ones, ones, d[4], d[5]);
+                    csa(twosB, ones, ones, d[6], d[7]);
+                    csa(foursB, twos, twos, twosA, twosB);
+                    csa(eightsA, fours, fours, foursA, foursB);
+                    csa(twosA, ones, ones, d[8], d[9]);
+                    csa(twosB, ones, ones, d[10], d[11]);
+                    csa(foursA, twos, twos, twosA, twosB);
+                    csa(twosA, ones, ones, d[12], d[13]);
+                    csa(twosB, ones, ones, d[14], d[15]);
+                    csa(foursB, twos, twos, twosA, twosB);
+                    csa(eightsB, fours, fours, foursA, foursB);
+                    csa(sixteens, eights, eights, eightsA, eightsB);
+
+                    // Ripple the sixteens into the upper planes
+                    for (size_t b=0; b<nplane; ++b) {
+                        word_t any = 0;
+                        for (size_t l=0; l<lanes; ++l) {
+                            word_t t = planes[b*lanes + l] & sixteens[l];
+                            planes[b*lanes + l] ^= sixteens[l];
+                            sixteens[l] = t;
+                            any |= t;
+                        }
+                        if (any == 0) {
+                            break;
+                        }
+                    }
+                }
+
+                // Read off the counts of the permutations of this chunk,
+                // adding up the planes weighted by their place value
+                size_t first = k*bits;
+                size_t len = std::min(lanes*bits, res.size() - first);
+                T* r = &res[first];
+                if (mode == assign) {
+                    std::fill(r, r + len, T(0));
+                }
+                bool isSub = mode == subtract;
+                expand_bits(ones, len, 0, r, isSub);
+                expand_bits(twos, len, 1, r, isSub);
+                expand_bits(fours, len, 2, r, isSub);
+                expand_bits(eights, len, 3, r, isSub);
+                for (size_t b=0; b<nplane; ++b) {
+                    expand_bits(planes + b*lanes, len, unsigned(b + 4), r, isSub);
+                }
+            }
         }
+    } // namespace bsl_detail
+
+    //
+    // *b*it-*sl*iced counting (BSL), see bsl_detail::count
+    //
+    template<class T> inline void bsl(   
+            const Perm_matrix<T>& pmat, //matrix of predefined permutations
+            const std::vector<int>& idx,//genotype index vector
+            std::valarray<T>& res,      //results are written into res
+            std::vector<detail::word_t>& buf) //counters, reused across calls
+    {
+        bsl_detail::count(pmat.sliceMat_, idx, res, buf, bsl_detail::assign);
+    }
+
+    template<class T> inline void bsl(   
+            const Perm_matrix<T>& pmat, //matrix of predefined permutations
+            const std::vector<int>& idx,//genotype index vector
+            std::valarray<T>& res)      //results are written into res
+    {
+        std::vector<detail::word_t> buf;
+        bsl(pmat, idx, res, buf);
     }
 
     //
@@ -50,15 +390,74 @@ namespace Permory { namespace permutation {
             const std::vector<int>& idx,//genotype index vector
             std::valarray<T>& res)      //results are written into res
     {
+        assert (res.size() == pmat.nperm());
         BOOST_FOREACH(int i, idx) {
-            assert (size_t(i) < pmat.tpermMat_.size());
-            res += pmat.tpermMat_[i]; 
+            assert (size_t(i) < pmat.nsubject());
+        }
+        if (pmat.isCompact()) {     //no transposed permutations
+            std::vector<detail::word_t> buf;
+            bsl_detail::count(pmat.sliceMat_, idx, res, buf, bsl_detail::add);
+            return;
         }
+        git_detail::add_rows(pmat.tpermMat_, idx, res);
     }
 
     //
     // *re*construction *m*emoization (REM)
     //
+    template<class T> inline void rem(   
+            const Perm_matrix<T>& pmat, //matrix of predefined permutations
+            const detail::word_t* w,    //dummy-coded data as n words
+            const detail::word_t* ww,   //words of a bitset similar to w
+            size_t n,
+            std::valarray<T>& res,      //results are written into res
+            std::vector<int>& add,      //scratch for the indices to add...
+            std::vector<int>& sub,      //... and to subtract
+            std::vector<detail::word_t>& buf) //counters if compact
+    {
+        using namespace Permory::detail;
+        const size_t bits = 8*sizeof(word_t);
+        add.clear();
+        sub.clear();
+        for (size_t k=0; k<n; ++k) {
+            // w[i]==1 vs ww[i]==0 - "positions" will be added
+            for (word_t x = w[k] & ~ww[k]; x; x &= x - 1) {
+                add.push_back(int(k*bits + lowest_bit(x)));
+            }
+            // w[i]==0 vs ww[i]==1 - ... will be subtracted 
+            for (word_t x = ww[k] & ~w[k]; x; x &= x - 1) {
+                sub.push_back(int(k*bits + lowest_bit(x)));
+            }
+        }
+        BOOST_FOREACH(int i, add) {
+            assert (size_t(i) < pmat.nsubject());
+        }
+        BOOST_FOREACH(int i, sub) {
+            assert (size_t(i) < pmat.nsubject());
+        }
+
+        // Add/subtract the transposed permutations of the differing positions
+        if (pmat.isCompact()) {
+            bsl_detail::count(pmat.sliceMat_, add, res, buf, bsl_detail::add);
+            bsl_detail::count(pmat.sliceMat_, sub, res, buf,
+                    bsl_detail::subtract);
+            return;
+        }
+        git_detail::add_rows(pmat.tpermMat_, add, res);
+        git_detail::subtract_rows(pmat.tpermMat_, sub, res);
+    }
+    template<class T> inline void rem(   
+            const Perm_matrix<T>& pmat,
+            const detail::word_t* w,
+            const detail::word_t* ww,
+            size_t n,
+            std::valarray<T>& res,
+            std::vector<int>& add,
+            std::vector<int>& sub)
+    {
+        std::vector<detail::word_t> buf;
+        rem(pmat, w, ww, n, res, add, sub, buf);
+    }
     template<class T> inline void rem(   
             const Perm_matrix<T>& pmat, //matrix of predefined permutations
             const bitset_t& b,          //dummy-coded data
@@ -66,23 +465,13 @@ namespace Permory { namespace permutation {
             std::valarray<T>& res)      //results are written into res
     {
         assert (b.size() == bb.size());
-        assert (b.size() == pmat.tpermMat_.nrow());
-        bitset_t b1 = b ^ bb;   
-        bitset_t b2 = b & b1; //b[i]==1 vs bb[i]==0 - "positions" will be added
-        b1 &= bb;             //b[i]==0 vs bb[i]==1 - ... will be subtracted 
-
-        // "Jump" to each differing position and add/subtract the 
-        // corresponding transposed permutations
-        size_t pos = b2.find_first(); 
-        while (pos < b2.size()) {   
-            res += pmat.tpermMat_[pos]; //adding
-            pos = b2.find_next(pos);
-        }
-        pos = b1.find_first();
-        while (pos < b1.size()) {   
-            res -= pmat.tpermMat_[pos]; //subtracting
-            pos = b1.find_next(pos);
-        }
+        assert (b.size() == pmat.nsubject());
+        std::vector<detail::word_t> w(b.num_blocks());
+        std::vector<detail::word_t> ww(bb.num_blocks());
+        boost::to_block_range(b, w.begin());
+        boost::to_block_range(bb, ww.begin());
+        std::vector<int> add, sub;
+        rem(pmat, &w[0], &ww[0], w.size(), res, add, sub);
     }
 
 } // namespace permutation
@@ -0,0 +1,229 @@
+// Copyright (c) 2026 The Permory contributors
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt.)
+
+#ifndef permory_permutation_cost_model_hpp
+#define permory_permutation_cost_model_hpp
+
+#include <algorithm>
+#include <ctime>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <valarray>
+#include <vector>
+
+#include <boost/dynamic_bitset.hpp>
+
+#include "detail/config.hpp"
+#include "boost_algorithms.hpp"
+#include "perm_matrix.hpp"
+#include "recode.hpp"
+
+namespace Permory { namespace permutation {
+
+    //
+    // Costs of the counting methods for one dummy code with k bits set, in
+    // units of one GIT step (adding up one row of transposed permutations),
+    // so GIT costs k by definition:
+    //  BAR: bar*nsubject
+    //  BSL: bsl_fixed + bsl_per_index*k
+    //  REM: rem_fixed + d, for a buffered code at hamming distance d
+    // The defaults were estimated with test/benchmark.cpp on a current x86
+    // CPU. Earlier versions assumed BAR to cost nsubject/6, which is far too
+    // much with hardware popcount. On other machines, calibrate (see below)
+    // should be used.
+    //
+    class Cost_model {
+        public:
+            // Ctor
+            Cost_model()
+                : bar(1.0/64.0), bsl_fixed(5.0), bsl_per_index(0.1),
+                rem_fixed(0.0)
+            {}
+
+            // Inspection
+            double bar_cost(size_t nsubject) const { return bar*nsubject; }
+            double bsl_cost(size_t k) const { return bsl_fixed + bsl_per_index*k; }
+
+            // Conversion
+            // Text format: one "name value" pair per line, '#' starts a comment
+            void write(std::ostream&) const;
+            void read(std::istream&);
+
+            double bar;
+            double bsl_fixed;
+            double bsl_per_index;
+            double rem_fixed;
+    };
+
+    // ========================================================================
+    // Cost_model implementation
+    inline void Cost_model::write(std::ostream& os) const
+    {
+        os << "# PERMORY cost model (units: GIT steps)\n"
+            << "bar " << bar << "\n"
+            << "bsl_fixed " << bsl_fixed << "\n"
+            << "bsl_per_index " << bsl_per_index << "\n"
+            << "rem_fixed " << rem_fixed << "\n";
+    }
+
+    inline void Cost_model::read(std::istream& is)
+    {
+        std::string name;
+        while (is >> name) {
+            if (name[0] == '#') {
+                std::getline(is, name);
+                continue;
+            }
+            double val;
+            if (not (is >> val) || val < 0) {
+                throw std::runtime_error("Bad value of '" + name
+                        + "' in cost model.");
+            }
+            if (name == "bar") bar = val;
+            else if (name == "bsl_fixed") bsl_fixed = val;
+            else if (name == "bsl_per_index") bsl_per_index = val;
+            else if (name == "rem_fixed") rem_fixed = val;
+            else {
+                throw std::runtime_error("Unknown entry '" + name
+                        + "' in cost model.");
+            }
+        }
+    }
+
+    namespace cost_detail {
+        // Calls of the methods to be timed
+        template<class T> struct Git_call {
+            const Perm_matrix<T>& pmat;
+            const std::vector<int>& idx;
+            std::valarray<T>& res;
+            Git_call(const Perm_matrix<T>& m, const std::vector<int>& i,
+                    std::valarray<T>& r) : pmat(m), idx(i), res(r) {}
+            void operator()() const { res = T(0); git(pmat, idx, res); }
+        };
+        template<class T> struct Bar_call {
+            const Perm_matrix<T>& pmat;
+            const bitset_t& b;
+            std::valarray<T>& res;
+            Bar_call(const Perm_matrix<T>& m, const bitset_t& bs,
+                    std::valarray<T>& r) : pmat(m), b(bs), res(r) {}
+            void operator()() const { bar(pmat, b, res); }
+        };
+        template<class T> struct Bsl_call {
+            const Perm_matrix<T>& pmat;
+            const std::vector<int>& idx;
+            std::valarray<T>& res;
+            std::vector<detail::word_t>& buf;
+            Bsl_call(const Perm_matrix<T>& m, const std::vector<int>& i,
+                    std::valarray<T>& r, std::vector<detail::word_t>& w)
+                : pmat(m), idx(i), res(r), buf(w) {}
+            void operator()() const { bsl(pmat, idx, res, buf); }
+        };
+        template<class T> struct Rem_call {
+            const Perm_matrix<T>& pmat;
+            const std::vector<detail::word_t>& w;
+            const std::vector<detail::word_t>& ww;
+            const std::valarray<T>& memo;
+            std::valarray<T>& res;
+            std::vector<int>& add;
+            std::vector<int>& sub;
+            Rem_call(const Perm_matrix<T>& m,
+                    const std::vector<detail::word_t>& w1,
+                    const std::vector<detail::word_t>& w2,
+                    const std::valarray<T>& mem, std::valarray<T>& r,
+                    std::vector<int>& a, std::vector<int>& s)
+                : pmat(m), w(w1), ww(w2), memo(mem), res(r), add(a), sub(s) {}
+            void operator()() const {
+                res = memo;
+                rem(pmat, &w[0], &ww[0], w.size(), res, add, sub);
+            }
+        };
+
+        // Seconds per call of f, timed over at least min_seconds
+        template<class F> double seconds_per_call(const F& f,
+                double min_seconds=0.02)
+        {
+            f();    //warm up caches
+            size_t reps = 1;
+            while (true) {
+                std::clock_t start = std::clock();
+                for (size_t r=0; r<reps; ++r) {
+                    f();
+                }
+                double sec = double(std::clock() - start)/CLOCKS_PER_SEC;
+                if (sec >= min_seconds || reps >= (size_t(1) << 24)) {
+                    return sec/double(reps);
+                }
+                reps *= 2;
+            }
+        }
+
+        // Dummy code with every step-th subject set
+        inline bitset_t every(size_t n, size_t step)
+        {
+            bitset_t b(n);
+            for (size_t i=0; i<n; i+=step) {
+                b.set(i);
+            }
+            return b;
+        }
+    } // namespace cost_detail
+
+    //
+    // Times the methods on the given permutations and fits the cost model,
+    // which takes a fraction of a second.
+    //
+    template<class T> Cost_model calibrate(const Perm_matrix<T>& pmat)
+    {
+        using namespace cost_detail;
+        Cost_model costs;
+        size_t n = pmat.nsubject();
+        if (n < 64 || pmat.nperm() == 0) {
+            return costs;   //too small to measure anything useful
+        }
+        std::valarray<T> res(T(0), pmat.nperm());
+
+        // One GIT step
+        std::vector<int> idx = index_code(every(n, 8));
+        double step = seconds_per_call(Git_call<T>(pmat, idx, res))
+            /double(idx.size());
+
+        if (pmat.hasBitmat()) {
+            bitset_t b = every(n, 2);
+            costs.bar = seconds_per_call(Bar_call<T>(pmat, b, res))
+                /step/double(n);
+        }
+        if (pmat.hasBitslice()) {
+            // Straight line through two points
+            std::vector<detail::word_t> buf;
+            std::vector<int> few = index_code(every(n, n/16));
+            std::vector<int> many = index_code(every(n, 2));
+            double t1 = seconds_per_call(Bsl_call<T>(pmat, few, res, buf))/step;
+            double t2 = seconds_per_call(Bsl_call<T>(pmat, many, res, buf))/step;
+            double slope = (t2 - t1)/double(many.size() - few.size());
+            costs.bsl_per_index = std::max(slope, 0.0);
+            costs.bsl_fixed = std::max(t1 - costs.bsl_per_index*few.size(), 0.0);
+        }
+
+        // REM of two codes differing in two bits, minus the two GIT steps
+        bitset_t b = every(n, 4);
+        bitset_t bb = b;
+        bb.flip(1);
+        bb.flip(n - 1);
+        std::vector<detail::word_t> w(b.num_blocks());
+        std::vector<detail::word_t> ww(bb.num_blocks());
+        boost::to_block_range(b, w.begin());
+        boost::to_block_range(bb, ww.begin());
+        std::valarray<T> memo(res);
+        std::vector<int> add, sub;
+        double t = seconds_per_call(
+                Rem_call<T>(pmat, w, ww, memo, res, add, sub))/step;
+        costs.rem_fixed = std::max(t - 2.0, 0.0);
+        return costs;
+    }
+
+} // namespace permutation
+} // namespace Permory
+
+#endif // include guard
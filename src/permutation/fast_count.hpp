@@ -6,40 +6,48 @@
 #ifndef permory_permutation_fast_count_hpp
 #define permory_permutation_fast_count_hpp
 
+#include <algorithm>
 #include <valarray>
 #include <vector>
 
 #include <boost/dynamic_bitset.hpp>
-#include <boost/circular_buffer.hpp>
+#include <boost/foreach.hpp>
 
 #include "detail/config.hpp"
 #include "detail/matrix.hpp" 
 #include "detail/vector.hpp" 
 #include "detail/pair.hpp"
+#include "detail/popcount.hpp"
 #include "gwas/locusdata.hpp"
 #include "perm_matrix.hpp"
 #include "boost_algorithms.hpp"
+#include "cost_model.hpp"
 #include "recode.hpp"
+#include "similarity_index.hpp"
 
 namespace Permory { namespace permutation {
     typedef boost::dynamic_bitset<> bitset_t;
 
     //
     // Helper class: we use this class in the buffer of class Fast_count in 
-    // order to save repeatedly counting bits during search in the buffer
+    // order to save repeatedly counting bits during search in the buffer.
+    // Besides the bitset, it keeps the bitset's words padded to a multiple of
+    // 64 bytes (see detail/popcount.hpp), which are used by the kernels.
     //
     class Bitset_with_count { 
         public:
             // Ctors
             Bitset_with_count() : cnt_(0) {}
             Bitset_with_count(const boost::dynamic_bitset<>& bs) 
-                : bs_(bs), cnt_(bs.count())
-            {}
+                : bs_(bs)
+            { update(); }
 
             // Inspection
             const boost::dynamic_bitset<>& get() const { return bs_; }
             size_t count() const { return cnt_; }
             size_t size() const { return bs_.size(); }
+            const detail::word_t* words() const { return &words_[0]; }
+            size_t nwords() const { return words_.size(); }
             bool operator<(const Bitset_with_count& b) const { 
                 return cnt_ < b.count(); 
             }
@@ -47,12 +55,19 @@ namespace Permory { namespace permutation {
             // Modification
             Bitset_with_count& operator=(const boost::dynamic_bitset<>& bs) {
                 bs_ = bs;
-                cnt_ = bs.count();
+                update();
                 return *this;
             }
+            // Same as operator=(dummy_code(start, end, val)) but reuses the
+            // memory if the size of the bitset does not change
+            template<class It, class D> void assign_dummy_code(
+                    It start, It end, const D& val);
+
         private:
+            void update();
             boost::dynamic_bitset<> bs_;
             size_t cnt_;
+            std::vector<detail::word_t> words_;
     };
 
     // Helper function
@@ -60,111 +75,278 @@ namespace Permory { namespace permutation {
     inline size_t hamming_dist(
             const Bitset_wc& b1, 
             const Bitset_wc& b2) {
-        return (b1.get() ^ b2.get()).count();
+        assert (b1.size() == b2.size());
+        return detail::xor_count_kernel()(b1.words(), b2.words(), b1.nwords());
     }
 
+    //
     // Permutation booster
+    //
+    // The dummy code to be counted and its result are kept in one of
+    // buffer_sz+1 slots allocated once, the "working" slot. Adding it to the
+    // buffer just turns the next slot into the working slot, overwriting the
+    // oldest buffered one, so in the steady state no memory is allocated
+    // and no results are copied.
+    //
+    // The newest scan_size buffered codes are searched linearly for the most
+    // similar one. Older ones, if any, are searched via a Similarity_index,
+    // which keeps long buffers (tails) cheap to search. Only these older
+    // codes are indexed.
+    //
     template<class T> class Fast_count {
         public:
             typedef std::pair<Bitset_with_count, std::valarray<T> > elem_t;
-            typedef boost::circular_buffer<elem_t> buffer_t;
-            typedef typename buffer_t::const_reverse_iterator buf_iterator;
 
             // Ctor + Dtor
             Fast_count(
                     boost::shared_ptr<Perm_matrix<T> >, 
-                    size_t buffer_sz=100); 
+                    size_t buffer_sz=100,
+                    const Cost_model& costs=Cost_model()); 
             ~Fast_count(){}
 
             // Inspector
             size_t get_tradeOff() const { return tradeOff_; }
-            bool empty_buffer() const { return buf_.empty(); }
-            bool hasMemoized() const { return (!empty_buffer()) && (itMem_ != buf_.rend()); }
+            bool empty_buffer() const { return nbuf_ == 0; }
+            bool hasMemoized() const { return itMem_ != npos; }
+            // Bytes per permutation of all result slots
+            static size_t bytes_per_permutation(size_t buffer_sz) {
+                return (buffer_sz + 1)*sizeof(T);
+            }
+
+            // The working slot
+            Bitset_with_count& code() { return slots_[work_].first; }
+            std::valarray<T>& result() { return slots_[work_].second; }
 
             // Modifier
-            void add_to_buffer(const Bitset_wc& b, const std::valarray<T>& v) {
-                buf_.push_back(std::make_pair(b, v)); 
-            }
+            void add_to_buffer();   //buffer code() together with result()
+            void set_cost_model(const Cost_model&);
 
             // Conversion
-            std::valarray<T> operator()(const Bitset_with_count&);
+            void count();           //count code() into result()
             size_t find_similar_bitset_in_buffer(const Bitset_with_count&, size_t toBeat);
 
+            static const size_t scan_size = 100;
+
         private:
+            static const size_t npos = size_t(-1);
+            size_t buffered(size_t k) const {   //slot of k-th newest entry
+                return (work_ + slots_.size() - k) % slots_.size();
+            }
+            void check_hit(size_t slot, const Bitset_with_count&, size_t& toBeat);
+
+            // Cheapest method besides REM for a code with cnt bits set
+            enum Method { git_method, bar_method, bsl_method };
+            Method cheapest(size_t cnt, double& cost) const;
+
             boost::shared_ptr<Perm_matrix<T> > permMatrix_;
-            size_t tradeOff_;
+            Cost_model costs_;
+            size_t tradeOff_;       //cost of BAR
+            size_t remFixed_;       //cost of REM besides the hamming distance
+            double remPerIndex_;    //cost of REM per differing bit
 
             // reconstruction memoization requires buffering input with results 
-            buffer_t buf_;
-            buf_iterator itMem_;    //Memorize position in buffer
+            std::vector<elem_t> slots_;
+            size_t work_;           //working slot
+            size_t nbuf_;           //number of buffered slots
+            size_t itMem_;          //Memorize position in buffer
+            Similarity_index index_;//codes older than scan_size
+            std::vector<size_t> candidates_;
+
+            // Memory reused by the counting methods
+            std::vector<int> indices_;
+            std::vector<int> indicesSub_;
+            std::vector<detail::word_t> counters_;
     };
 
+    // =====================================================================
+    // Bitset_with_count implementation
+    template<class It, class D> inline void Bitset_with_count::assign_dummy_code(
+            It start, It end, const D& val)
+    {
+        bs_.resize(std::distance(start, end));
+        bs_.reset();
+        for (size_t i=0; start != end; ++start, ++i) {
+            if (*start == val) { 
+                bs_.set(i);      
+            }
+        }
+        update();
+    }
+
+    inline void Bitset_with_count::update()
+    {
+        using detail::words_per_line;
+        cnt_ = bs_.count();
+        size_t n = (bs_.num_blocks() + words_per_line - 1)/words_per_line
+            *words_per_line;
+        if (n != words_.size()) {
+            words_.assign(std::max(n, words_per_line), 0);
+        }
+        boost::to_block_range(bs_, words_.begin());
+    }
+
     // =====================================================================
     // Fast_count implementation
     template<class T> inline Fast_count<T>::Fast_count(
             boost::shared_ptr<Perm_matrix<T> > pmat, 
-            size_t buffer_sz) 
-        : permMatrix_(pmat), buf_(buffer_sz)
+            size_t buffer_sz,
+            const Cost_model& costs) 
+        : permMatrix_(pmat), 
+        slots_(buffer_sz + 1), work_(0), nbuf_(0), itMem_(npos)
     { 
-        tradeOff_ = (size_t)(double(pmat->nsubject())/6.0); 
-        itMem_ = buf_.rend();
+        set_cost_model(costs);
+        indices_.reserve(pmat->nsubject());
+        indicesSub_.reserve(pmat->nsubject());
+        result().resize(pmat->nperm());
+        if (buffer_sz > scan_size) {
+            const size_t bits = 8*sizeof(detail::word_t);
+            index_ = Similarity_index(slots_.size(), 
+                    (pmat->nsubject() + bits - 1)/bits);
+        }
+    }
+
+    template<class T> inline void Fast_count<T>::add_to_buffer()
+    {
+        work_ = (work_ + 1) % slots_.size();
+        nbuf_ = std::min(nbuf_ + 1, slots_.size() - 1);
+        itMem_ = npos;
+
+        // The new working slot is either unused so far (results are
+        // allocated when needed, as long tails may be rather large), or it
+        // holds the oldest buffered code, which is dropped.
+        if (result().size() != permMatrix_->nperm()) {
+            result().resize(permMatrix_->nperm());
+        }
+        // Codes are indexed once they leave the linearly searched part, so
+        // that index lookups are not spent on codes scanned anyway
+        if (not index_.empty()) {
+            index_.erase(work_);
+            if (nbuf_ > scan_size) {
+                size_t slot = buffered(scan_size + 1);
+                index_.insert(slot, slots_[slot].first.words());
+            }
+        }
+    }
+
+    template<class T> inline void Fast_count<T>::set_cost_model(
+            const Cost_model& costs)
+    {
+        costs_ = costs;
+        tradeOff_ = (size_t)(costs.bar_cost(permMatrix_->nsubject())); 
+        remFixed_ = (size_t)(costs.rem_fixed + 0.5);
+        remPerIndex_ = 1.0;
+        if (permMatrix_->isCompact()) { //REM adds and subtracts by BSL
+            remFixed_ = (size_t)(costs.rem_fixed + 2.0*costs.bsl_fixed + 0.5);
+            remPerIndex_ = costs.bsl_per_index;
+        }
+    }
+
+    template<class T> inline typename Fast_count<T>::Method
+        Fast_count<T>::cheapest(size_t cnt, double& cost) const
+    {
+        if (permMatrix_->isCompact()) {  //BSL is the only direct method
+            cost = costs_.bsl_cost(cnt);
+            return bsl_method;
+        }
+        Method m = git_method;
+        cost = double(cnt);
+        if (permMatrix_->hasBitmat() && not (cnt < tradeOff_)) {
+            m = bar_method;
+            cost = double(tradeOff_);
+        }
+        if (permMatrix_->hasBitslice() && costs_.bsl_cost(cnt) < cost) {
+            m = bsl_method;
+            cost = costs_.bsl_cost(cnt);
+        }
+        return m;
+    }
+
+    template<class T> inline void Fast_count<T>::check_hit(
+            size_t slot, const Bitset_with_count& b, size_t& toBeat)
+    {
+        const Bitset_with_count& x = slots_[slot].first;
+
+        // bit count is always a lower bound for the hamming distance, thus 
+        // providing a quick estimate whether it is worth to compute the 
+        // hamming distance at all. With compact permutations, the costs are
+        // far below bit counts, so the difference of the bit counts, a lower
+        // bound as well, is used.
+        bool isWorth = x.count() < toBeat;
+        if (permMatrix_->isCompact()) {
+            size_t diff = x.count() > b.count() ? x.count() - b.count()
+                : b.count() - x.count();
+            isWorth = size_t(remPerIndex_*double(diff)) + remFixed_ < toBeat;
+        }
+
+        if (isWorth) { 
+            size_t cost = size_t(remPerIndex_*double(hamming_dist(b, x)))
+                + remFixed_;    //of REM
+            if (cost < toBeat) {  //more similar bitset found?
+                toBeat = cost;
+                itMem_ = slot;  //remember this position
+            }
+        }
     }
 
     //
     // Takes a bitset b and searches for a bitset x in the buffer that shows the
     // smallest hamming distance between b and all bitsets in the buffer. The
-    // function basically returns min(b.count(), "minimal hamming distance")
+    // function basically returns min(b.count(), "minimal hamming distance"),
+    // or more precisely, the lowest cost of counting b by any method.
     //
     template<class T> inline size_t Fast_count<T>::find_similar_bitset_in_buffer(
             const Bitset_with_count& b, size_t toBeat)
     {
-        if (permMatrix_->hasBitmat()) { toBeat = std::min(toBeat, this->tradeOff_); } //TODO auslagern mittels get_tradeOff()
-        itMem_ = buf_.rend();
-        for (buf_iterator itBuf=buf_.rbegin(); itBuf!=buf_.rend(); itBuf++) {
+        double direct;
+        cheapest(b.count(), direct);
+        toBeat = std::min(toBeat, size_t(direct));
+        itMem_ = npos;
+        size_t nscan = std::min(nbuf_, size_t(scan_size));
+        for (size_t k=1; k<=nscan; k++) {   //newest first
             if (toBeat == 0) break; //cannot improve anymore 
-
-            // bit count is always a lower bound for the hamming distance, thus 
-            // providing a quick estimate whether it is worth to compute the 
-            // hamming distance at all
-            bool isWorth = (itBuf->first).count() < toBeat;
-
-            if (isWorth) { 
-                size_t hd = hamming_dist(b, itBuf->first);
-                if (hd < toBeat) {  //more similar bitset found?
-                    toBeat = hd;
-                    itMem_ = itBuf; //remember this position
-                }
+            check_hit(buffered(k), b, toBeat);
+        }
+        if (nbuf_ > nscan && toBeat > 0) {
+            index_.candidates(b.words(), candidates_);
+            BOOST_FOREACH(size_t slot, candidates_) {
+                if (toBeat == 0) break;
+                check_hit(slot, b, toBeat);     //not scanned above
             }
         }
         return toBeat;
     }
 
-    template<class T> inline std::valarray<T> Fast_count<T>::operator()(
-            const Bitset_with_count& dummy_code) 
-                    //boost::shared_ptr<Perm_matrix<T> > permMat) //TODO
+    template<class T> inline void Fast_count<T>::count()
     {
-        std::vector<int> indices = index_code(dummy_code.get()); 
+        const Bitset_with_count& dummy_code = code();
+        std::valarray<T>& res = result();
+        size_t cnt = dummy_code.count();    //size of the index code
 
-        // First determine, which of the accelerating methods are available
+        // REM, if a similar code was found, else the method of lowest
+        // estimated cost according to the cost model
         bool useREM = this->hasMemoized();          //reconstruction memoization
-        bool noBAR = !(permMatrix_->hasBitmat());   //bit arithmetics available?
-        bool useGIT = indices.size() < tradeOff_;   //genotype indexing
+        double cost;
+        Method method = cheapest(cnt, cost);
 
-        std::valarray<T> res(T(0), permMatrix_->nperm());
         if (useREM) {
             // recall/memoize previous results and update them using rem method
-            res = itMem_->second;
-            rem(*permMatrix_, dummy_code.get(), (itMem_->first).get(), res);
+            const elem_t& mem = slots_[itMem_];
+            res = mem.second;
+            rem(*permMatrix_, dummy_code.words(), mem.first.words(),
+                    dummy_code.nwords(), res, indices_, indicesSub_, counters_);
+        }
+        else if (method == bsl_method) {
+            index_code(dummy_code.get(), indices_);
+            bsl(*permMatrix_, indices_, res, counters_);
         }
-        else if(useGIT 
-                || noBAR) { //if BAR method NOT available, we use GIT anyway 
-            res = 0;        //init *all* valarray entries with 0
-            git(*permMatrix_, indices, res); 
+        else if (method == git_method) {
+            index_code(dummy_code.get(), indices_);
+            res = T(0);     //init *all* valarray entries with 0
+            git(*permMatrix_, indices_, res); 
         }
         else {
-            bar(*permMatrix_, dummy_code.get(), res); 
+            bar(*permMatrix_, dummy_code.words(), res); 
         }
-        return res;
     }
 
 } // namespace permutation
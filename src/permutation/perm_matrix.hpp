@@ -5,18 +5,26 @@
 #ifndef permory_permutation_perm_matrix_hpp
 #define permory_permutation_perm_matrix_hpp
 
+#include <algorithm>
+#include <stdexcept>
 #include <valarray>
 #include <vector>
 
 #include <boost/dynamic_bitset.hpp>
 
 #include "detail/config.hpp"
+#include "detail/aligned_matrix.hpp"
+#include "detail/bit_matrix.hpp"
 #include "permutation/permutation.hpp"
 
 namespace Permory { namespace permutation {
 
     // Stores permutations and provides fast methods for counting
     // allele/genotype frequencies in these permutations
+    //
+    // A compact matrix keeps dichotomous (0/1) permutations only bit-sliced,
+    // that is, with one bit instead of one T per subject and permutation, and
+    // all methods count on the bit-sliced form.
     template<class T> class Perm_matrix {
         public:
             typedef boost::dynamic_bitset<> bitset_t;
@@ -26,11 +34,27 @@ namespace Permory { namespace permutation {
                     const size_t nperm,
                     const Permutation& p, 
                     const std::vector<T>& trait,
-                    bool useBitmat=true); 
+                    bool useBitmat=true,
+                    bool useBitslice=false,
+                    bool compact=false); 
+            // Continue the sequence of permutations of another matrix, that
+            // is, together both matrices hold the same permutations as a
+            // single matrix of both sizes created with the same Permutation
+            Perm_matrix(
+                    const size_t nperm,
+                    const Permutation& p, 
+                    const Perm_matrix& previous);
             // Inspection
-            size_t nperm() const { return tpermMat_.ncol(); }
-            size_t nsubject() const { return tpermMat_.nrow(); }
+            size_t nperm() const { return nperm_; }
+            size_t nsubject() const { return trait_.size(); }
             bool hasBitmat() const { return hasBitmat_; }
+            bool hasBitslice() const { return hasBitslice_; }
+            bool isCompact() const { return isCompact_; }
+            std::vector<T> permutation(size_t i) const; //i-th permuted trait
+            // Bytes per permutation of a matrix of the given kind
+            static size_t bytes_per_permutation(size_t nsubject,
+                    bool useBitmat=true, bool useBitslice=false,
+                    bool compact=false);
 
             // Modification
             void reshuffle(const size_t, const Permutation&);
@@ -38,38 +62,155 @@ namespace Permory { namespace permutation {
             // For definitions of these functions see booster.hpp
             template<class T2> friend void rem(const Perm_matrix<T2>&, 
                     const bitset_t& b, const bitset_t&, std::valarray<T2>&); 
+            template<class T2> friend void rem(const Perm_matrix<T2>&,
+                    const detail::word_t*, const detail::word_t*, size_t,
+                    std::valarray<T2>&, std::vector<int>&, std::vector<int>&);
+            template<class T2> friend void rem(const Perm_matrix<T2>&,
+                    const detail::word_t*, const detail::word_t*, size_t,
+                    std::valarray<T2>&, std::vector<int>&, std::vector<int>&,
+                    std::vector<detail::word_t>&);
             template<class T2> friend void bar(const Perm_matrix<T2>&,
                     const bitset_t&, std::valarray<T2>&);
+            template<class T2> friend void bar(const Perm_matrix<T2>&,
+                    const detail::word_t*, std::valarray<T2>&);
             template<class T2> friend void git(const Perm_matrix<T2>&,
                 const std::vector<int>&, std::valarray<T2>&); 
+            template<class T2> friend void bsl(const Perm_matrix<T2>&,
+                const std::vector<int>&, std::valarray<T2>&); 
+            template<class T2> friend void bsl(const Perm_matrix<T2>&,
+                const std::vector<int>&, std::valarray<T2>&,
+                std::vector<detail::word_t>&); 
 
         private:
-            detail::Matrix<T> tpermMat_;    //transposed permutations
-            std::vector<bitset_t> bitMat_;  //bit-coded permutations
+            void fill(const Permutation&, std::vector<T> v);
+
+            size_t nperm_;
+            detail::Aligned_matrix<T> tpermMat_;  //transposed permutations
+                                            //  (empty if compact)
+            detail::Bit_matrix bitMat_;     //bit-coded permutations (by row)
+            detail::Bit_matrix sliceMat_;   //bit-sliced permutations, that is,
+                                            //  bit i of row j is subject j in
+                                            //  permutation i
             bool hasBitmat_;
+            bool hasBitslice_;
+            bool isCompact_;
+            std::vector<T> trait_;          //not permuted
     };
 
     template<class T> inline Perm_matrix<T>::Perm_matrix( 
             const size_t nperm,
             const Permutation& p, 
             const std::vector<T>& trait, 
-            bool useBitmat
+            bool useBitmat,
+            bool useBitslice,
+            bool compact
             ) 
-        : tpermMat_(trait.size(), nperm), hasBitmat_(useBitmat)
+        : nperm_(nperm),
+        tpermMat_(compact ? 0 : trait.size(), compact ? 0 : nperm),
+        hasBitmat_(useBitmat && not compact),
+        hasBitslice_(useBitslice || compact), isCompact_(compact),
+        trait_(trait)
     {
-        if (useBitmat) {
-            bitset_t bs(trait.size());
-            bitMat_.resize(nperm, bs);
-            //bitMat_.resize(nperm, bitset_t(trait.size()));
+        if (compact) {
+            BOOST_FOREACH(T t, trait) {
+                if (not (t == T(0) || t == T(1))) {
+                    throw std::invalid_argument(
+                            "Compact permutations need a 0/1 trait.");
+                }
+            }
         }
-        std::vector<T> v = trait;                
-        for (size_t i=0; i<nperm; ++i) {  
-            p.shuffle(&v[0], v.size()); //next permutation
+        fill(p, trait);
+    }
+    template<class T> inline Perm_matrix<T>::Perm_matrix( 
+            const size_t nperm,
+            const Permutation& p, 
+            const Perm_matrix& previous
+            ) 
+        : nperm_(nperm),
+        tpermMat_(previous.isCompact_ ? 0 : previous.nsubject(),
+                previous.isCompact_ ? 0 : nperm),
+        hasBitmat_(previous.hasBitmat_),
+        hasBitslice_(previous.hasBitslice_), isCompact_(previous.isCompact_),
+        trait_(previous.trait_)
+    {
+        assert(previous.nperm() > 0);
+        // Each permutation shuffles the one before, so start with the last,
+        // unless each one is shuffled from the original order on its own
+        if (p.isCounterBased()) {
+            fill(p, trait_);
+        }
+        else {
+            fill(p, previous.permutation(previous.nperm() - 1));
+        }
+    }
+    template<class T> inline std::vector<T> Perm_matrix<T>::permutation(
+            size_t i) const
+    {
+        assert(i < nperm_);
+        std::vector<T> v(nsubject());
+        if (isCompact_) {
+            const size_t bits = 8*sizeof(detail::word_t);
             for (size_t j=0; j<v.size(); ++j) {
+                v[j] = T((sliceMat_[j][i/bits] >> (i % bits)) & 1);
+            }
+            return v;
+        }
+        for (size_t j=0; j<v.size(); ++j) {
+            v[j] = tpermMat_[j][i];
+        }
+        return v;
+    }
+    template<class T> inline size_t Perm_matrix<T>::bytes_per_permutation(
+            size_t nsubject, bool useBitmat, bool useBitslice, bool compact)
+    {
+        size_t slice = (nsubject + 7)/8;    //one bit per subject
+        if (compact) {
+            return slice;
+        }
+        size_t n = nsubject*sizeof(T);
+        if (useBitmat) {    //rows are padded to 64 bytes
+            n += (nsubject + 511)/512*64;
+        }
+        if (useBitslice) {
+            n += slice;
+        }
+        return n;
+    }
+    template<class T> inline void Perm_matrix<T>::fill(
+            const Permutation& p,
+            std::vector<T> v)
+    {
+        size_t nperm = nperm_;
+        if (hasBitmat_) {
+            detail::Bit_matrix(nperm, v.size()).swap(bitMat_);
+        }
+        if (hasBitslice_) {
+            detail::Bit_matrix(v.size(), nperm).swap(sliceMat_);
+        }
+        const size_t bits = 8*sizeof(detail::word_t);
+        size_t first = p.isCounterBased() ? p.draw(nperm) : 0;
+        for (size_t i=0; i<nperm; ++i) {  
+            if (p.isCounterBased()) {
+                std::copy(trait_.begin(), trait_.end(), v.begin());
+                p.shuffle(&v[0], v.size(), first + i);
+            }
+            else {
+                p.shuffle(&v[0], v.size()); //next permutation
+            }
+            for (size_t j=0; j<v.size() && not isCompact_; ++j) {
                 tpermMat_[j][i] = v[j];     //fill by column 
             }
-            if (useBitmat) {
-                bitMat_[i] = detail::vector_to_bitset(v);
+            if (hasBitmat_ || hasBitslice_) {
+                bitset_t bs = detail::vector_to_bitset(v);
+                if (hasBitmat_) {
+                    bitMat_.set_row(i, bs);
+                }
+                if (hasBitslice_) {
+                    detail::word_t mask = detail::word_t(1) << (i % bits);
+                    for (size_t j=bs.find_first(); j<bs.size(); j=bs.find_next(j)) {
+                        sliceMat_[j][i/bits] |= mask;
+                    }
+                }
             }
         }
     }
@@ -77,13 +218,11 @@ namespace Permory { namespace permutation {
             const size_t nperm,
             const Permutation& p)
     {
-        assert(tpermMat_.ncol() > 0);
+        assert(nperm_ > 0);
         // Copy trait out of the first column
-        std::vector<T> some_trait(tpermMat_.nrow());
-        for (size_t i=0; i<tpermMat_.nrow(); i++) {
-            some_trait[i] = tpermMat_[i][0];
-        }
-        *this = Perm_matrix(nperm, p, some_trait, hasBitmat_);
+        std::vector<T> some_trait(permutation(0));
+        *this = Perm_matrix(nperm, p, some_trait, hasBitmat_, hasBitslice_,
+                isCompact_);
     }
 
 } // namespace permutation
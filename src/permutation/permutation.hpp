@@ -5,12 +5,18 @@
 #ifndef permory_permutation_permutation_hpp
 #define permory_permutation_permutation_hpp
 
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
 #include <gsl/gsl_rng.h>
 #include <gsl/gsl_randist.h>
 
 #include "detail/exception.hpp"
 #include "detail/matrix.hpp"
 #include "detail/vector.hpp"
+#include "permutation/philox.hpp"
 
 namespace Permory { namespace permutation {
 
@@ -19,10 +25,17 @@ namespace Permory { namespace permutation {
     //  the boost random generator interface as (at the time of implementation) 
     //  it was considerably more efficient
     //
+    //  Optionally, permutations are drawn with a counter-based generator
+    //  instead (see philox.hpp): permutation number i then is a shuffle of
+    //  the original order using stream i, so it does not depend on any other
+    //  permutation and can be created by any thread or process.
+    //
     class Permutation {
         public:
             // Ctor
-            explicit Permutation(size_t seed=17061979) : seed_(seed) {
+            explicit Permutation(size_t seed=17061979, bool isCounterBased=false)
+                : seed_(seed), isCounterBased_(isCounterBased), next_(0)
+            {
                 rg = gsl_rng_alloc(gsl_rng_mt19937); //Mersenne Twister
                 gsl_rng_set(rg, seed); //init random generator with seed
             }
@@ -31,18 +44,60 @@ namespace Permory { namespace permutation {
 
             // Inspector
             size_t get_seed() const { return seed_; }
+            bool isCounterBased() const { return isCounterBased_; }
             template<typename T> void shuffle(T* pv, size_t sz) const {
                 gsl_ran_shuffle(rg, pv, sz, sizeof(T));
             }
+            // Shuffle as permutation number i of the counter-based generator
+            template<typename T> void shuffle(T* pv, size_t sz, size_t i) const;
+
+            // Number of the next permutation of the counter-based generator;
+            // draw(n) takes the next n numbers and returns the first one.
+            size_t next_index() const { return next_; }
+            size_t draw(size_t n) const { next_ += n; return next_ - n; }
+            // State of both generators, from which set_state continues
+            std::vector<char> state() const;
 
             // Modifier
-            void set_seed(size_t x) { seed_ = x; gsl_rng_set(rg, seed_); }
-            void reset_seed() { gsl_rng_set(rg, seed_); }
+            void set_seed(size_t x) { seed_ = x; gsl_rng_set(rg, seed_); next_ = 0; }
+            void reset_seed() { gsl_rng_set(rg, seed_); next_ = 0; }
+            void set_next_index(size_t i) { next_ = i; }
+            void set_state(const std::vector<char>&);
 
         private:
             size_t seed_;   //random seed
+            bool isCounterBased_;
+            mutable size_t next_;   //next permutation (counter-based)
             gsl_rng* rg;    //random generator
     };
+
+    // ========================================================================
+    // Permutation implementation
+    inline std::vector<char> Permutation::state() const
+    {
+        std::vector<char> v(sizeof(next_) + gsl_rng_size(rg));
+        std::memcpy(&v[0], &next_, sizeof(next_));
+        std::memcpy(&v[sizeof(next_)], gsl_rng_state(rg), gsl_rng_size(rg));
+        return v;
+    }
+
+    inline void Permutation::set_state(const std::vector<char>& v)
+    {
+        if (v.size() != sizeof(next_) + gsl_rng_size(rg)) {
+            throw std::invalid_argument("Invalid random generator state.");
+        }
+        std::memcpy(&next_, &v[0], sizeof(next_));
+        std::memcpy(gsl_rng_state(rg), &v[sizeof(next_)], gsl_rng_size(rg));
+    }
+
+    template<typename T> inline void Permutation::shuffle(
+            T* pv, size_t sz, size_t i) const
+    {
+        Philox_stream rng(seed_, i);
+        for (size_t j=sz; j>1; --j) {   //Fisher-Yates
+            std::swap(pv[j - 1], pv[rng.below(j)]);
+        }
+    }
 } // namespace permutation
 } // namespace Permory
 
@@ -0,0 +1,110 @@
+// Copyright (c) 2026 The Permory contributors
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt.)
+
+#ifndef permory_permutation_philox_hpp
+#define permory_permutation_philox_hpp
+
+#include <algorithm>
+
+#include <boost/cstdint.hpp>
+
+#include "detail/config.hpp"
+
+namespace Permory { namespace permutation {
+
+    //
+    // Philox4x32-10 counter-based random number generator (Salmon et al.,
+    // Parallel random numbers: as easy as 1, 2, 3. SC'11). Each (key,
+    // counter) pair is mapped to four random words without any state, thus
+    // any part of any stream can be produced independently of the others.
+    //
+    inline void philox4x32(
+            const boost::uint32_t ctr[4],
+            const boost::uint32_t key[2],
+            boost::uint32_t out[4])
+    {
+        using boost::uint32_t;
+        using boost::uint64_t;
+        const uint32_t m0 = 0xD2511F53, m1 = 0xCD9E8D57;
+        const uint32_t w0 = 0x9E3779B9, w1 = 0xBB67AE85;
+        uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+        uint32_t k0 = key[0], k1 = key[1];
+        for (int r=0; r<10; ++r) {
+            uint64_t p0 = uint64_t(m0)*c0;
+            uint64_t p1 = uint64_t(m1)*c2;
+            uint32_t n0 = uint32_t(p1 >> 32) ^ c1 ^ k0;
+            uint32_t n2 = uint32_t(p0 >> 32) ^ c3 ^ k1;
+            c1 = uint32_t(p1);
+            c3 = uint32_t(p0);
+            c0 = n0;
+            c2 = n2;
+            k0 += w0;
+            k1 += w1;
+        }
+        out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+    }
+
+    //
+    // Stream number s of the generator keyed by seed, that is, the outputs
+    // for the counters (0, 0, s), (1, 0, s), (2, 0, s), ...
+    //
+    class Philox_stream {
+        public:
+            // Ctor
+            Philox_stream(boost::uint64_t seed, boost::uint64_t s) : pos_(4) {
+                key_[0] = boost::uint32_t(seed);
+                key_[1] = boost::uint32_t(seed >> 32);
+                ctr_[0] = 0;
+                ctr_[1] = 0;
+                ctr_[2] = boost::uint32_t(s);
+                ctr_[3] = boost::uint32_t(s >> 32);
+            }
+
+            // Conversion
+            boost::uint32_t operator()();   //next 32 random bits
+            size_t below(size_t n);         //uniform in [0, n), n < 2^32
+
+        private:
+            boost::uint32_t key_[2];
+            boost::uint32_t ctr_[4];
+            boost::uint32_t out_[4];
+            size_t pos_;                    //next unused word of out_
+    };
+
+    // ========================================================================
+    // Philox_stream implementation
+    inline boost::uint32_t Philox_stream::operator()()
+    {
+        if (pos_ == 4) {
+            philox4x32(ctr_, key_, out_);
+            if (++ctr_[0] == 0) {
+                ++ctr_[1];
+            }
+            pos_ = 0;
+        }
+        return out_[pos_++];
+    }
+
+    // Multiply and reject (D. Lemire), which is unbiased
+    inline size_t Philox_stream::below(size_t n)
+    {
+        using boost::uint32_t;
+        using boost::uint64_t;
+        assert (n > 0 && uint64_t(n) < (uint64_t(1) << 32));
+        uint64_t m = uint64_t((*this)())*n;
+        uint32_t low = uint32_t(m);
+        if (low < n) {
+            uint32_t threshold = uint32_t(-uint32_t(n)) % uint32_t(n);
+            while (low < threshold) {
+                m = uint64_t((*this)())*n;
+                low = uint32_t(m);
+            }
+        }
+        return size_t(m >> 32);
+    }
+
+} // namespace permutation
+} // namespace Permory
+
+#endif // include guard
@@ -41,15 +41,18 @@ namespace Permory { namespace permutation {
     // Derive index code from a bitset, that is, return a vector of all indices
     // that are set in the bitset
     //
-    std::vector<int> index_code(const boost::dynamic_bitset<>& b)
+    inline void index_code(const boost::dynamic_bitset<>& b, std::vector<int>& v)
+    {
+        v.clear();  //keeps the capacity, so v can be reused without allocation
+        for (size_t i=b.find_first(); i<b.size(); i=b.find_next(i)) {
+            v.push_back(int(i));
+        }
+    }
+    inline std::vector<int> index_code(const boost::dynamic_bitset<>& b)
     {
         std::vector<int> v;
         v.reserve(b.count());
-        for (int i=0; i<int(b.size()); ++i) {
-            if (b.test(i)) {    //if (b[i] == 1)
-                v.push_back(i);
-            }
-        }
+        index_code(b, v);
         return v;
     }
 
@@ -0,0 +1,193 @@
+// Copyright (c) 2026 The Permory contributors
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt.)
+
+#ifndef permory_permutation_similarity_index_hpp
+#define permory_permutation_similarity_index_hpp
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+#include "detail/config.hpp"
+#include "detail/popcount.hpp"
+
+namespace Permory { namespace permutation {
+
+    //
+    // Index over a fixed number of slots holding bitsets (given as words),
+    // which yields candidates similar to a query bitset in terms of hamming
+    // distance without looking at all slots (multi-index hashing).
+    //
+    // The words are split into bands, and each band is hashed into a table
+    // of its own. Two bitsets differing in d bits differ in at most d bands,
+    // so all bitsets within distance nbands()-1 share at least one band with
+    // the query; more distant ones do so if their differences happen to
+    // cluster in few bands, as for markers in LD. Sharing a band does not
+    // guarantee being found, though: bands without any bit set are not
+    // indexed, since they would make all sparse bitsets candidates of each
+    // other, and only the max_probe most recently inserted slots of a band
+    // are listed.
+    //
+    class Similarity_index {
+        public:
+            // Ctor
+            Similarity_index(size_t capacity=0, size_t nwords=0,
+                    size_t max_bands=16, size_t max_probe=32);
+
+            // Inspection
+            bool empty() const { return capacity_ == 0; }
+            size_t capacity() const { return capacity_; }
+            size_t nbands() const { return nbands_; }
+
+            // Modification
+            void insert(size_t slot, const detail::word_t* w);
+            void erase(size_t slot);
+
+            // Conversion
+            // Slots sharing a band with w, each listed once and, per band,
+            // the most recently inserted first. At most max_probe slots are
+            // taken from each band.
+            void candidates(const detail::word_t* w, std::vector<size_t>& v);
+
+        private:
+            typedef boost::uint64_t key_t;
+            static const size_t none = size_t(-1);
+
+            bool band_key(size_t j, const detail::word_t* w, key_t& key) const;
+            size_t& head(size_t j, key_t key) {
+                return head_[j*nbuckets_ + (key & (nbuckets_ - 1))];
+            }
+
+            size_t capacity_;
+            size_t nbands_;
+            size_t nbuckets_;               //per band, a power of 2
+            size_t maxProbe_;
+            std::vector<size_t> bandBegin_; //first word of each band
+
+            // Doubly linked lists of slots per bucket, indexed by
+            // j*capacity_ + slot for band j
+            std::vector<key_t> key_;
+            std::vector<size_t> next_;
+            std::vector<size_t> prev_;
+            std::vector<char> linked_;
+            std::vector<size_t> head_;
+
+            std::vector<size_t> stamp_;     //query that listed a slot last
+            size_t query_;
+    };
+
+    // ========================================================================
+    // Similarity_index implementation
+    inline Similarity_index::Similarity_index(size_t capacity, size_t nwords,
+            size_t max_bands, size_t max_probe)
+        : capacity_(capacity), nbands_(std::min(max_bands, nwords)),
+        nbuckets_(1), maxProbe_(max_probe), query_(0)
+    {
+        if (nbands_ == 0) {
+            capacity_ = 0;
+            return;
+        }
+        while (nbuckets_ < 2*capacity_) {
+            nbuckets_ *= 2;
+        }
+        bandBegin_.resize(nbands_ + 1);
+        for (size_t j=0; j<=nbands_; ++j) {
+            bandBegin_[j] = j*nwords/nbands_;
+        }
+        key_.resize(nbands_*capacity_);
+        next_.resize(nbands_*capacity_, none);
+        prev_.resize(nbands_*capacity_, none);
+        linked_.resize(nbands_*capacity_, 0);
+        head_.resize(nbands_*nbuckets_, none);
+        stamp_.resize(capacity_, 0);
+    }
+
+    // Hash of the words of band j; false if none of them has a bit set
+    inline bool Similarity_index::band_key(size_t j,
+            const detail::word_t* w, key_t& key) const
+    {
+        key = key_t(0x9e3779b97f4a7c15ULL);
+        bool any = false;
+        for (size_t i=bandBegin_[j]; i<bandBegin_[j + 1]; ++i) {
+            any = any || w[i] != 0;
+            key = (key ^ key_t(w[i]))*key_t(0xff51afd7ed558ccdULL);
+            key ^= key >> 32;
+        }
+        return any;
+    }
+
+    inline void Similarity_index::insert(size_t slot, const detail::word_t* w)
+    {
+        assert (slot < capacity_);
+        erase(slot);
+        for (size_t j=0; j<nbands_; ++j) {
+            size_t e = j*capacity_ + slot;
+            if (not band_key(j, w, key_[e])) {
+                continue;
+            }
+            size_t& h = head(j, key_[e]);
+            next_[e] = h;
+            prev_[e] = none;
+            if (h != none) {
+                prev_[j*capacity_ + h] = slot;
+            }
+            h = slot;
+            linked_[e] = 1;
+        }
+    }
+
+    inline void Similarity_index::erase(size_t slot)
+    {
+        assert (slot < capacity_);
+        for (size_t j=0; j<nbands_; ++j) {
+            size_t e = j*capacity_ + slot;
+            if (not linked_[e]) {
+                continue;
+            }
+            if (prev_[e] == none) {
+                head(j, key_[e]) = next_[e];
+            }
+            else {
+                next_[j*capacity_ + prev_[e]] = next_[e];
+            }
+            if (next_[e] != none) {
+                prev_[j*capacity_ + next_[e]] = prev_[e];
+            }
+            linked_[e] = 0;
+        }
+    }
+
+    inline void Similarity_index::candidates(const detail::word_t* w,
+            std::vector<size_t>& v)
+    {
+        v.clear();
+        if (++query_ == 0) {    //wrapped around
+            std::fill(stamp_.begin(), stamp_.end(), 0);
+            query_ = 1;
+        }
+        for (size_t j=0; j<nbands_; ++j) {
+            key_t key;
+            if (not band_key(j, w, key)) {
+                continue;
+            }
+            size_t nprobe = 0;
+            for (size_t s=head(j, key); s!=none && nprobe<maxProbe_;
+                    s=next_[j*capacity_ + s]) {
+                if (key_[j*capacity_ + s] != key) {
+                    continue;   //other key in the same bucket
+                }
+                nprobe++;
+                if (stamp_[s] != query_) {
+                    stamp_[s] = query_;
+                    v.push_back(s);
+                }
+            }
+        }
+    }
+
+} // namespace permutation
+} // namespace Permory
+
+#endif // include guard
@@ -41,12 +41,18 @@ namespace Permory { namespace statistic {
 
                 // Inspection
                 size_t size() const { return testPool_.size(); }
+                static Memory_use memory_use(const detail::Parameter&,
+                        size_t nsubject);
 
                 // Modification
                 void renew_permutations(
                         const Permutation* pp,  //creates the permutations
                         size_t nperm,           //number of permutations
                         size_t tail_size);      //parameter of the permutation booster
+                // Use permutations created elsewhere, e.g. by another thread
+                void use_permutations(
+                        boost::shared_ptr<Perm_matrix<T> > pmat,
+                        size_t tail_size);
 
                 // Conversion
                 // Compute test statistics for the data
@@ -70,6 +76,8 @@ namespace Permory { namespace statistic {
 
                 // For caching purpose
                 bool useBitarithmetic_;
+                bool useBitslice_;
+                bool useCompact_;
         };
     // ========================================================================
     // Dichotom implementations
@@ -80,7 +88,8 @@ namespace Permory { namespace statistic {
                 gwas::Gwas::const_inderator ind_end,
                 const Permutation* pp)
         : trait_(prepare_trait(ind_begin, ind_end)),
-        useBitarithmetic_(par.useBar)
+        useBitarithmetic_(par.useBar), useBitslice_(par.useBsl),
+        useCompact_(par.compactPerm)
     {
         this->testPool_.add(par);
         this->marginal_sum_ = std::accumulate(trait_.begin(), trait_.end(), 0);
@@ -90,24 +99,46 @@ namespace Permory { namespace statistic {
         }
     }
 
+    template<uint K, uint L, class T> inline
+        Memory_use Dichotom<K, L, T>::memory_use(const detail::Parameter& par,
+                size_t nsubject)
+        {
+            Memory_use m;
+            m.matrix = Perm_matrix<T>::bytes_per_permutation(nsubject,
+                    par.useBar, par.useBsl, par.compactPerm);
+            m.boosters = (L+1)*Fast_count<T>::bytes_per_permutation(
+                    par.tail_size);
+            m.tables = sizeof(Con_tab<K, L>) + sizeof(double);
+            return m;
+        }
+
     template<uint K, uint L, class T> inline
         void Dichotom<K, L, T>::renew_permutations(const Permutation* pp, size_t nperm,
                 size_t tail_size)
         {
+            // Create and store permutations in matrix
+            boost::shared_ptr<Perm_matrix<T> > pmat(
+                    new Perm_matrix<T>(nperm, *pp, trait_, useBitarithmetic_,
+                        useBitslice_, useCompact_));
+            use_permutations(pmat, tail_size);
+        }
+
+    template<uint K, uint L, class T> inline
+        void Dichotom<K, L, T>::use_permutations(
+                boost::shared_ptr<Perm_matrix<T> > pmat, size_t tail_size)
+        {
+            size_t nperm = pmat->nperm();
             this->tabs_.resize(nperm);
             this->tMax_.clear();
             this->tMax_.resize(nperm);
-            this->res_.resize(L+1, nperm); //one extra row to account for missings
-
-            // Create and store permutations in matrix
-            boost::shared_ptr<Perm_matrix<T> > pmat(
-                    new Perm_matrix<T>(nperm, *pp, trait_, useBitarithmetic_));
+            this->permMatrix_ = pmat;
 
             // Prepare permutation booster
             this->boosters_.clear();
             this->boosters_.reserve(L+1);
             for (uint i=0; i<L+1; i++) {
-                this->boosters_.push_back(new Fast_count<T>(pmat, tail_size));
+                this->boosters_.push_back(new Fast_count<T>(pmat, tail_size,
+                            this->costModel_));
             }
         }
 
@@ -203,8 +234,8 @@ namespace Permory { namespace statistic {
                 if (ok) {
                     uint n = uniques->second; //frequency of both (cases + controls)
                     for (uint t=0; t<this->tabs_.size(); ++t) {
-                        this->tabs_[t][0][c] = this->res_[j][t];     //cases r[j]
-                        this->tabs_[t][1][c] = n - this->res_[j][t]; //controls s[j]
+                        this->tabs_[t][0][c] = (*this->res_[j])[t];     //cases r[j]
+                        this->tabs_[t][1][c] = n - (*this->res_[j])[t]; //controls s[j]
                     }
                     c++;
                 }
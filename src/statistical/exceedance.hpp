@@ -0,0 +1,278 @@
+// Copyright (c) 2026 The Permory contributors
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt.)
+
+#ifndef permory_statistic_exceedance_hpp
+#define permory_statistic_exceedance_hpp
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/serialization/deque.hpp>
+#include <boost/serialization/vector.hpp>
+
+#include "detail/config.hpp"
+
+namespace Permory { namespace statistic {
+
+    //
+    // Fixed-size sketch of a distribution of non-negative values: a histogram
+    // with logarithmic bins (cf. DDSketch, Masson et al., VLDB 2019), so any
+    // quantile in [min_value, max_value] is off by at most 0.5% of its value.
+    // Smaller values are put into the first bin, larger ones into the last.
+    //
+    class Quantile_sketch {
+        public:
+            // Ctor
+            Quantile_sketch() : bins_(nbins(), 0), n_(0) { }
+
+            // Inspection
+            size_t size() const { return n_; }
+            double value(size_t r) const;   //value of rank r (0: smallest)
+            static size_t memory_use() { return nbins()*sizeof(size_t); }
+
+            // Modification
+            void add(double x) { ++bins_[bin(x)]; ++n_; }
+            void merge(const Quantile_sketch&);
+
+        private:
+            static double gamma() { return 1.01; }
+            static double min_value() { return 1e-6; }
+            static double max_value() { return 1e6; }
+            static size_t nbins() {
+                return 2 + size_t(std::ceil(std::log(max_value()/min_value())
+                            /std::log(gamma())));
+            }
+            size_t bin(double x) const;
+
+            std::vector<size_t> bins_;
+            size_t n_;
+
+            // serialization stuff
+            friend class boost::serialization::access;
+            template<class Archive>
+            void serialize(Archive & ar, const unsigned int version)
+            {
+                ar & bins_;
+                ar & n_;
+            }
+    };
+
+    //
+    // Number of permutations whose max test statistic reaches the test
+    // statistic of each marker, i.e. the single step counts, accumulated
+    // block by block. Only the counts per distinct marker statistic, the
+    // ntail largest permutation statistics and a quantile sketch are kept, so
+    // the memory does not grow with the number of permutations.
+    //
+    class Exceedance_counts {
+        public:
+            // Ctor
+            Exceedance_counts() : n_(0), ntail_(0) { }
+            Exceedance_counts(
+                    const std::deque<double>& t,    //test statistics
+                    size_t ntail);  //number of largest statistics to keep
+
+            // Inspection
+            size_t nperm() const { return n_; }
+            // #(T_perm >= t) for any t given on construction
+            size_t count(double t) const;
+            std::deque<size_t> counts(const std::deque<double>& t) const;
+            // Largest permutation statistics, sorted increasingly
+            const std::deque<double>& largest() const { return largest_; }
+            // Permutation statistic of rank round(q*nperm()) (0: smallest),
+            // which is exact if among largest(), else taken from the sketch
+            double quantile(double q) const;
+            // Bytes taken for nmarker test statistics at most, whatever the
+            // number of permutations
+            static size_t memory_use(size_t nmarker, size_t ntail);
+
+            // Modification
+            void add(std::vector<double>& tmax);    //sorts tmax
+            void merge(const Exceedance_counts&);
+
+        private:
+            template<class It> void add_largest(It first, It last);
+
+            std::vector<double> t_;     //distinct test statistics, increasing
+            std::vector<size_t> cnt_;   //#(T_perm >= t_[i])
+            size_t n_;                  //number of permutations
+            size_t ntail_;
+            std::deque<double> largest_;
+            Quantile_sketch sketch_;
+
+            // serialization stuff
+            friend class boost::serialization::access;
+            template<class Archive>
+            void serialize(Archive & ar, const unsigned int version)
+            {
+                ar & t_;
+                ar & cnt_;
+                ar & n_;
+                ar & ntail_;
+                ar & largest_;
+                ar & sketch_;
+            }
+    };
+
+    //
+    // Number of largest max test statistics to keep exactly: enough for the
+    // 1-alpha percentile of nperm permutations and the tail fit (--gpd, up
+    // to 250 exceedances), but at most 2^20 (8 MB), beyond which the
+    // percentile is taken from the sketch
+    //
+    inline size_t exceedance_tail_size(double alpha, size_t nperm)
+    {
+        size_t n = size_t(std::ceil(alpha*nperm)) + 1;
+        return std::min(std::max(n, size_t(251)), size_t(1) << 20);
+    }
+
+    // Sums up the counts of two sets of permutations (of the same markers)
+    struct Exceedance_merge : public std::binary_function<
+        Exceedance_counts, Exceedance_counts, Exceedance_counts>
+    {
+        Exceedance_counts operator()(const Exceedance_counts& a,
+                const Exceedance_counts& b) const
+        {
+            Exceedance_counts result(a);
+            result.merge(b);
+            return result;
+        }
+    };
+
+    // ========================================================================
+    // Quantile_sketch implementation
+    inline size_t Quantile_sketch::bin(double x) const
+    {
+        if (not (x > min_value())) {
+            return 0;
+        }
+        double i = std::ceil(std::log(x/min_value())/std::log(gamma()));
+        return std::min(size_t(i), bins_.size() - 1);
+    }
+
+    inline double Quantile_sketch::value(size_t r) const
+    {
+        assert (r < n_);
+        size_t i = 0;
+        for (size_t sum=bins_[0]; sum<=r; sum+=bins_[i]) {
+            ++i;
+        }
+        if (i == 0) {
+            return 0;
+        }
+        // Bin i holds (min_value*gamma^(i-1), min_value*gamma^i]
+        return min_value()*std::pow(gamma(), double(i) - 0.5);
+    }
+
+    inline void Quantile_sketch::merge(const Quantile_sketch& s)
+    {
+        for (size_t i=0; i<bins_.size(); ++i) {
+            bins_[i] += s.bins_[i];
+        }
+        n_ += s.n_;
+    }
+
+    // ========================================================================
+    // Exceedance_counts implementation
+    inline size_t Exceedance_counts::memory_use(size_t nmarker, size_t ntail)
+    {
+        return nmarker*(sizeof(double) + sizeof(size_t))   //t_ and cnt_
+            + ntail*sizeof(double)                          //largest_
+            + Quantile_sketch::memory_use();
+    }
+
+    inline Exceedance_counts::Exceedance_counts(const std::deque<double>& t,
+            size_t ntail)
+        : t_(t.begin(), t.end()), n_(0), ntail_(ntail)
+    {
+        std::sort(t_.begin(), t_.end());
+        t_.erase(std::unique(t_.begin(), t_.end()), t_.end());
+        cnt_.resize(t_.size(), 0);
+    }
+
+    inline size_t Exceedance_counts::count(double t) const
+    {
+        std::vector<double>::const_iterator it = std::lower_bound(
+                t_.begin(), t_.end(), t);
+        if (it == t_.end() || *it != t) {
+            throw std::invalid_argument("Exceedances of unknown test statistic.");
+        }
+        return cnt_[it - t_.begin()];
+    }
+
+    inline std::deque<size_t> Exceedance_counts::counts(
+            const std::deque<double>& t) const
+    {
+        std::deque<size_t> result(t.size());
+        for (size_t i=0; i<t.size(); ++i) {
+            result[i] = count(t[i]);
+        }
+        return result;
+    }
+
+    inline double Exceedance_counts::quantile(double q) const
+    {
+        assert (n_ > 0);
+        size_t r = std::min(size_t(std::floor(q*double(n_) + 0.5)), n_ - 1);
+        size_t fromTop = n_ - 1 - r;
+        if (fromTop < largest_.size()) {
+            return largest_[largest_.size() - 1 - fromTop];
+        }
+        return sketch_.value(r);
+    }
+
+    inline void Exceedance_counts::add(std::vector<double>& tmax)
+    {
+        std::sort(tmax.begin(), tmax.end());
+
+        // Both sorted, so one pass over each
+        std::vector<double>::const_iterator it = tmax.begin();
+        for (size_t i=0; i<t_.size(); ++i) {
+            while (it != tmax.end() && *it < t_[i]) {
+                ++it;
+            }
+            cnt_[i] += tmax.end() - it;
+        }
+        n_ += tmax.size();
+
+        for (it=tmax.begin(); it!=tmax.end(); ++it) {
+            sketch_.add(*it);
+        }
+        size_t k = std::min(ntail_, tmax.size());
+        add_largest(tmax.end() - k, tmax.end());
+    }
+
+    inline void Exceedance_counts::merge(const Exceedance_counts& e)
+    {
+        if (e.t_ != t_) {
+            throw std::invalid_argument("Exceedances of different test statistics.");
+        }
+        for (size_t i=0; i<cnt_.size(); ++i) {
+            cnt_[i] += e.cnt_[i];
+        }
+        n_ += e.n_;
+        sketch_.merge(e.sketch_);
+        add_largest(e.largest_.begin(), e.largest_.end());
+    }
+
+    // Merge sorted values into largest_ and keep the ntail_ largest
+    template<class It> void Exceedance_counts::add_largest(It first, It last)
+    {
+        std::deque<double> merged;
+        std::merge(largest_.begin(), largest_.end(), first, last,
+                std::back_inserter(merged));
+        if (merged.size() > ntail_) {
+            merged.erase(merged.begin(), merged.end() - ntail_);
+        }
+        largest_.swap(merged);
+    }
+
+} // namespace statistic
+} // namespace Permory
+
+#endif // include guard
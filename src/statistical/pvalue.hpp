@@ -6,8 +6,10 @@
 #ifndef permory_pvalue_hpp
 #define permory_pvalue_hpp
 
-#include <vector>
+#include <cmath>
 #include <deque>
+#include <utility>
+#include <vector>
 #include <gsl/gsl_cdf.h>
 
 #include "detail/config.hpp"
@@ -53,6 +55,42 @@ namespace Permory { namespace statistic {
         return p;
     }
 
+    //
+    // Wilson score interval of the probability estimated by count out of n
+    // permutations (n > 0) at the given confidence level
+    std::pair<double, double> pvalue_interval(
+            size_t count,
+            size_t n,
+            double confidence=0.99)
+    {
+        double z = gsl_cdf_ugaussian_Pinv(1 - (1 - confidence)/2);
+        double z2 = z*z;
+        double p = double(count)/double(n);
+        double center = (p + z2/(2*n))/(1 + z2/n);
+        double half = z/(1 + z2/n)*std::sqrt(p*(1 - p)/n + z2/(4.0*n*n));
+        return std::make_pair(std::max(0.0, center - half),
+                std::min(1.0, center + half));
+    }
+
+    //
+    // Whether the single step p-values of the given counts are resolved,
+    // that is, each confidence interval is narrower than precision*alpha,
+    // so the p-value is as precise as requested
+    bool pvalues_resolved(
+            const std::deque<size_t>& counts,   //see single_step_counts
+            size_t nperm,                       //number of permutations
+            double alpha,
+            double precision)
+    {
+        for (size_t i=0; i<counts.size(); ++i) {
+            std::pair<double, double> ci = pvalue_interval(counts[i], nperm);
+            if (ci.second - ci.first > precision*alpha) {
+                return false;
+            }
+        }
+        return true;
+    }
+
     //
     // Computes step down counts
     std::deque<size_t> step_down_counts(
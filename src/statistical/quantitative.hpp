@@ -45,12 +45,17 @@ namespace Permory { namespace statistic {
                         const Permutation* pp=0);       //pre-stored permutations
 
                 // Inspection
+                static Memory_use memory_use(const Parameter&, size_t nsubject);
 
                 // Modification
                 void renew_permutations(
                         const Permutation* pp,  //creates the permutations
                         size_t nperm,           //number of permutations
                         size_t tail_size);      //parameter of the permutation booster
+                // Use permutations created elsewhere, e.g. by another thread
+                void use_permutations(
+                        boost::shared_ptr<Perm_matrix<pair_t> > pmat,
+                        size_t tail_size);
 
                 // Conversion
                 // Compute test statistics for the data
@@ -105,10 +110,32 @@ namespace Permory { namespace statistic {
         }
     }
 
+    template<uint L> inline Memory_use Quantitative<L>::memory_use(
+            const Parameter& par, size_t nsubject)
+    {
+        Memory_use m;
+        m.matrix = Perm_matrix<pair_t>::bytes_per_permutation(nsubject, false);
+        m.boosters = (L+1)*Fast_count<pair_t>::bytes_per_permutation(
+                par.tail_size);
+        m.tables = sizeof(std::vector<pair_t>) + (L+1)*sizeof(pair_t)
+            + sizeof(double);
+        return m;
+    }
+
     template<uint L> inline
         void Quantitative<L>::renew_permutations(const Permutation* pp, size_t nperm,
                 size_t tail_size)
         {
+            boost::shared_ptr<Perm_matrix<pair_t> > pmat(
+                    new Perm_matrix<pair_t>(nperm, *pp, nomdenom_buf_, false));
+            use_permutations(pmat, tail_size);
+        }
+
+    template<uint L> inline
+        void Quantitative<L>::use_permutations(
+                boost::shared_ptr<Perm_matrix<pair_t> > pmat, size_t tail_size)
+        {
+            size_t nperm = pmat->nperm();
             this->pairs_.resize(nperm);
             for (size_t i = 0; i < this->pairs_.size(); ++i) {
                 this->pairs_[i].resize(L+1);
@@ -116,15 +143,14 @@ namespace Permory { namespace statistic {
 
             this->tMax_.clear();
             this->tMax_.resize(nperm);
-
-            boost::shared_ptr<Perm_matrix<pair_t> > pmat(
-                    new Perm_matrix<pair_t>(nperm, *pp, nomdenom_buf_, false));
+            this->permMatrix_ = pmat;
 
             // Prepare permutation booster
             this->boosters_.clear();
             this->boosters_.reserve(L+1);
             for (uint i=0; i<L+1; i++) {
-                this->boosters_.push_back(new Fast_count<pair_t>(pmat, tail_size));
+                this->boosters_.push_back(new Fast_count<pair_t>(pmat, tail_size,
+                            this->costModel_));
             }
         }
 
@@ -193,8 +219,6 @@ namespace Permory { namespace statistic {
                 throw std::runtime_error("Bad domain cardinality in permutation test.");
             }
             test_stat_->update(data);
-            this->res_.resize(L+1, this->tMax_.size());  // one extra row for missings
-
             bool useBooster = (not this->boosters_.empty());
             if (useBooster) {
                 this->do_permutation(data);
@@ -211,7 +235,7 @@ namespace Permory { namespace statistic {
                 bool ok = not (uniques->first == data.get_undef());
                 if (ok) {
                     for (uint t=0; t < this->pairs_.size(); ++t) {
-                        this->pairs_[t][c] = this->res_[j][t];
+                        this->pairs_[t][c] = (*this->res_[j])[t];
                     }
                     c++;
                 }
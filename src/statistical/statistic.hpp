@@ -23,6 +23,17 @@ namespace Permory { namespace statistic {
     using namespace permutation;
     using namespace Permory::detail;
 
+    //
+    // Bytes per permutation of the structures a statistic object creates for
+    // a block of permutations. The permutation matrix may be shared by
+    // several objects (threads), the other parts are their own.
+    //
+    struct Memory_use {
+        size_t matrix;      //permutations
+        size_t boosters;    //result slots of the permutation boosters
+        size_t tables;      //contingency tables (or sums) and max statistics
+    };
+
     //
     // Base class for all classes analyzing genotype data.
     //
@@ -30,21 +41,45 @@ namespace Permory { namespace statistic {
         public:
             // Iterator pass through
             typedef typename std::vector<double>::const_iterator const_iterator;
+            typedef Perm_matrix<T> perm_matrix_t;
+            typedef T count_t;      //permutation counts (or sums)
             const_iterator tmax_begin() const { return tMax_.begin(); }
             const_iterator tmax_end() const { return tMax_.end(); }
 
+            // Inspection
+            boost::shared_ptr<Perm_matrix<T> > permutation_matrix() const {
+                return permMatrix_;
+            }
+
+            // Modification
+            // Costs deciding the method of counting, see cost_model.hpp
+            void set_cost_model(const Cost_model& costs) {
+                costModel_ = costs;
+                for (size_t i=0; i<boosters_.size(); ++i) {
+                    boosters_[i].set_cost_model(costs);
+                }
+            }
+            // Free the permutations and boosters, e.g. before those of the
+            // next block are created, so both need not fit into memory
+            void release_permutations() {
+                boosters_.clear();
+                permMatrix_.reset();
+            }
 
         protected:
             // This function does the "permutation work"
             template<class D> void do_permutation(const gwas::Locus_data<D>&);
 
             T marginal_sum_;       // sum of all nomdenom_buf_ elements
+            boost::shared_ptr<Perm_matrix<T> > permMatrix_; //may be shared
             boost::ptr_vector<Fast_count<T> > boosters_;
+            Cost_model costModel_;  //of all boosters
 
             // contains the intermediate result as contingency table in
             // dichotom and extension of the nominator and denominator in
-            // quantitative.
-            Matrix<T> res_;   //intermediate results
+            // quantitative. Row i is the result slot of boosters_[i], which
+            // is computed in place, thus only pointers are stored here.
+            std::vector<const std::valarray<T>*> res_;   //intermediate results
 
             std::vector<double> tMax_;  //max test statistics
     };
@@ -55,8 +90,8 @@ namespace Permory { namespace statistic {
         Statistic<T>::do_permutation(const gwas::Locus_data<D>& data)
     {
         size_t card = data.domain_cardinality();
-        std::vector<uint> boost_index(card);    //indices of applied booster
-        std::vector<Bitset_with_count> dummy_codes(card);
+        assert (card <= boosters_.size());
+        res_.resize(boosters_.size());
 
         // the unique_iterator is defined in discretedata.hpp:
         // std::map<elem_type, count_type> unique_;//unique elements with counts
@@ -65,13 +100,15 @@ namespace Permory { namespace statistic {
         size_t worst_idx = 0;
         for (uint i=0; i < card; i++) {
             D val = it->first;         
-            dummy_codes[i] = dummy_code<D>(data.begin(), data.end(), val);
+            Bitset_with_count& code = boosters_[i].code();
+            code.assign_dummy_code(data.begin(), data.end(), val);
+            res_[i] = &boosters_[i].result();
 
             // Search for the most similar bitset in the buffer with respect to 
             // hamming distance. The lower bound of the distance is the bit 
             // count of the dummy code.
-            size_t cnt = dummy_codes[i].count();
-            size_t dist = boosters_[i].find_similar_bitset_in_buffer(dummy_codes[i], cnt);
+            size_t cnt = code.count();
+            size_t dist = boosters_[i].find_similar_bitset_in_buffer(code, cnt);
 
             // Keep track of the worst boostable element, which is the one with
             // highest occurences of the code and/or the least similarity to
@@ -86,16 +123,17 @@ namespace Permory { namespace statistic {
         // Permute for each genotype code, except the one that can be least
         // boosted for permutation, and for which thus the result will be 
         // derived using the marginal sum.
-        res_[worst_idx] = marginal_sum_; //init with marginal sum
+        std::valarray<T>& worst = boosters_[worst_idx].result();
+        worst = marginal_sum_; //init with marginal sum
         for (uint i=0; i < card; i++) {
             if (i != worst_idx) {
-                res_[i] = boosters_[i](dummy_codes[i]);
-                res_[worst_idx] -= res_[i];
-                boosters_[i].add_to_buffer(dummy_codes[i], res_[i]);
+                boosters_[i].count();
+                worst -= boosters_[i].result();
+                boosters_[i].add_to_buffer();
             }
         }
         // Finally update booster's buffer of the "worst index" 
-        boosters_[worst_idx].add_to_buffer(dummy_codes[worst_idx], res_[worst_idx]);
+        boosters_[worst_idx].add_to_buffer();
     }
 
 
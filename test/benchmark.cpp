@@ -0,0 +1,86 @@
+// Copyright (c) 2026 The Permory contributors
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt.)
+
+//
+// Timing of the permutation methods (BAR, GIT and BSL) for different numbers
+// of subjects and dummy-code frequencies. Not part of the test suite; build
+// and run it explicitly with 'bjam benchmark' in this directory.
+//
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <valarray>
+#include <vector>
+
+#include <boost/dynamic_bitset.hpp>
+
+#include "detail/config.hpp"
+#include "detail/popcount.hpp"
+#include "permutation/boost_algorithms.hpp"
+#include "permutation/perm_matrix.hpp"
+#include "permutation/permutation.hpp"
+#include "permutation/recode.hpp"
+
+using namespace std;
+using namespace Permory::permutation;
+using namespace Permory::detail;
+
+typedef unsigned short count_t;
+enum Method { method_bar, method_git, method_bsl };
+
+// Milliseconds per call of the method
+double time_method(Method method, const Perm_matrix<count_t>& pmat,
+        const boost::dynamic_bitset<>& b, size_t reps)
+{
+    vector<int> idx = index_code(b);
+    valarray<count_t> res(count_t(0), pmat.nperm());
+    clock_t start = clock();
+    for (size_t r=0; r<reps; ++r) {
+        switch (method) {
+            case method_bar: bar(pmat, b, res); break;
+            case method_git: res = 0; git(pmat, idx, res); break;
+            case method_bsl: bsl(pmat, idx, res); break;
+        }
+    }
+    return 1000.0*double(clock() - start)/CLOCKS_PER_SEC/double(reps);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t nperm = 10000;
+    size_t nsubjects[] = {500, 2000, 8000};
+    double freqs[] = {0.01, 0.05, 0.1, 0.2, 0.3, 0.5};
+
+    cout << "BAR kernel: " << and_count_kernel().first << endl;
+    cout << "nperm = " << nperm << ", time in ms per call" << endl;
+    cout << setw(8) << "nsubj" << setw(8) << "freq" << setw(8) << "count"
+        << setw(10) << "BAR" << setw(10) << "GIT" << setw(10) << "BSL" << endl;
+
+    Permutation pp;
+    for (size_t i=0; i<sizeof(nsubjects)/sizeof(size_t); ++i) {
+        size_t n = nsubjects[i];
+        vector<count_t> trait(n, 0);
+        for (size_t j=0; j<n/2; ++j) {
+            trait[j] = 1;
+        }
+        Perm_matrix<count_t> pmat(nperm, pp, trait, true, true);
+        size_t reps = std::max(size_t(1), 20000/n);
+
+        for (size_t f=0; f<sizeof(freqs)/sizeof(double); ++f) {
+            boost::dynamic_bitset<> b(n);
+            size_t step = size_t(1.0/freqs[f] + 0.5);
+            for (size_t j=0; j<n; j+=step) {
+                b[j] = 1;
+            }
+            cout << setw(8) << n << setw(8) << freqs[f] << setw(8) << b.count()
+                << fixed << setprecision(3)
+                << setw(10) << time_method(method_bar, pmat, b, reps)
+                << setw(10) << time_method(method_git, pmat, b, reps)
+                << setw(10) << time_method(method_bsl, pmat, b, reps)
+                << endl;
+            cout.unsetf(ios::fixed);
+        }
+    }
+    return 0;
+}
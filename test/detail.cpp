@@ -9,6 +9,9 @@
 #include "detail/matrix.hpp"
 #include "detail/functors.hpp"
 #include "detail/pair.hpp"
+#include "detail/thread_team.hpp"
+#include "detail/bit_matrix.hpp"
+#include "detail/popcount.hpp"
 #include "test.hpp"
 
 #include <utility>
@@ -194,6 +197,79 @@ void pair_helper_test() {
 }
 
 
+struct Mark_job {
+    Mark_job(vector<int>& v) : v_(v) {}
+    void operator()(size_t i) const { 
+        v_[i]++; 
+        if (v_[i] > 2) {
+            throw std::runtime_error("thrown by thread");
+        }
+    }
+    vector<int>& v_;
+};
+
+struct Throw_int_job {
+    void operator()(size_t i) const { 
+        if (i == 1) {
+            throw 1;
+        }
+    }
+};
+
+void thread_team_test()
+{
+    Thread_team team(4);
+    BOOST_CHECK_EQUAL( team.size(), size_t(4) );
+
+    vector<int> v(4, 0);
+    team.run(Mark_job(v));
+    team.run(Mark_job(v));
+    for (size_t i=0; i<v.size(); ++i) {
+        BOOST_CHECK_EQUAL( v[i], 2 );
+    }
+    // Exceptions are passed to the calling thread
+    BOOST_CHECK_THROW( team.run(Mark_job(v)), std::runtime_error );
+    BOOST_CHECK_THROW( team.run(Throw_int_job()), std::runtime_error );
+
+    Thread_team single;
+    vector<int> w(1, 0);
+    single.run(Mark_job(w));
+    BOOST_CHECK_EQUAL( w[0], 1 );
+}
+
+void bit_matrix_test()
+{
+    // Rows of odd length are padded to 64 byte boundaries
+    size_t ncol = 1000;
+    Bit_matrix m(3, ncol);
+    BOOST_CHECK_EQUAL( m.nrow(), size_t(3) );
+    BOOST_CHECK_EQUAL( m.ncol(), ncol );
+    BOOST_CHECK_EQUAL( m.nwords()*sizeof(word_t) % 64, size_t(0) );
+    BOOST_CHECK_EQUAL( size_t(m[1]) % 64, size_t(0) );
+
+    dynamic_bitset<> a(ncol), b(ncol);
+    for (size_t i=0; i<ncol; ++i) {
+        a[i] = (i*7 % 3) == 0;
+        b[i] = (i*11 % 5) < 2;
+    }
+    m.set_row(0, a);
+    m.set_row(2, b);
+    Bit_matrix copy(m);
+    vector<word_t> w;
+    copy.to_words(a, w);
+    BOOST_CHECK_EQUAL( w.size(), m.nwords() );
+
+    // Every kernel must agree with dynamic_bitset
+    size_t n = m.nwords();
+    BOOST_CHECK( available_and_count_kernels().back().first == "generic" );
+    typedef pair<string, and_count_fn> kernel_t;
+    BOOST_FOREACH(kernel_t k, available_and_count_kernels()) {
+        BOOST_CHECK_EQUAL( k.second(&w[0], copy[0], n), a.count() );
+        BOOST_CHECK_EQUAL( k.second(&w[0], copy[1], n), size_t(0) );
+        BOOST_CHECK_EQUAL( k.second(&w[0], copy[2], n), (a & b).count() );
+    }
+}
+
 test_suite* init_unit_test_suite( int argc, char* argv[] )
 {
     test_suite *test = BOOST_TEST_SUITE("Functions and classes from src/detail");
@@ -205,6 +281,10 @@ test_suite* init_unit_test_suite( int argc, char* argv[] )
 
     test->add(BOOST_TEST_CASE(&pair_helper_test));
 
+    test->add(BOOST_TEST_CASE(&thread_team_test));
+
+    test->add(BOOST_TEST_CASE(&bit_matrix_test));
+
     return test;
 }
 
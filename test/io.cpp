@@ -5,9 +5,24 @@
 #define PERMORY_TEST gwas_test
 
 #include <fstream>
+#include <map>
+#include <sstream>
+
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/text_oarchive.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include "detail/parameter.hpp"
+#include "gwas/marker_source.hpp"
+#include "gwas/packed_locus_store.hpp"
 #include "gwas/read_phenotype_data.hpp"
+#include "io/line_reader.hpp"
+#include "io/input_filters.hpp"
+#include "io/plink_bed.hpp"
+#include "io/tokenizer.hpp"
 #include "test.hpp"
 
 using namespace std;
@@ -102,6 +117,376 @@ void determine_phenotype_domain_test() {
     }
 }
 
+void check_same_locus_data(const Locus_data<char>& a, const Locus_data<char>& b)
+{
+    BOOST_CHECK(vector<char>(a.begin(), a.end()) == vector<char>(b.begin(), b.end()));
+    BOOST_CHECK(a.unique_with_counts() == b.unique_with_counts());
+    typedef std::multimap<uint, char> Counts;
+    BOOST_CHECK(Counts(a.counts_begin(), a.counts_end())
+            == Counts(b.counts_begin(), b.counts_end()));
+    BOOST_CHECK_EQUAL(a.get_undef(), b.get_undef());
+    BOOST_CHECK_EQUAL(a.get_minor(), b.get_minor());
+    BOOST_CHECK_EQUAL(a.get_major(), b.get_major());
+}
+
+void packed_locus_store_test()
+{
+    Packed_locus_store store;
+    BOOST_CHECK(store.empty());
+
+    // Genotypes with a domain element not present in the data
+    char g[] = "0100?1110010";
+    Locus_data<char> geno(vector<char>(&g[0], &g[0]+12), '?');
+    geno.add_to_domain('2');
+    store.add(geno);
+
+    // Alleles of odd length
+    char a[] = "ACCA?CA";
+    Locus_data<char> alle(vector<char>(&a[0], &a[0]+7), '?');
+    store.add(alle);
+
+    // More than four distinct values need one byte per value
+    char m[] = "0123456?";
+    Locus_data<char> many(vector<char>(&m[0], &m[0]+8), '?');
+    store.add(many);
+
+    BOOST_CHECK_EQUAL(store.size(), size_t(3));
+    BOOST_CHECK_EQUAL(store.nbytes(), size_t(3 + 2 + 8));
+
+    boost::scoped_ptr<Locus_data<char> > p(store.get(0));
+    check_same_locus_data(*p, geno);
+    p.reset(store.get(1));
+    check_same_locus_data(*p, alle);
+    p.reset(store.get(2));
+    check_same_locus_data(*p, many);
+
+    // The same with one scratch buffer for all, longer data first
+    vector<char> scratch;
+    p.reset(store.get(0, scratch));
+    check_same_locus_data(*p, geno);
+    p.reset(store.get(2, scratch));
+    check_same_locus_data(*p, many);
+    p.reset(store.get(1, scratch));
+    check_same_locus_data(*p, alle);
+
+    // Serialized, as sent to other processes (MPI)
+    stringstream ss;
+    {
+        boost::archive::text_oarchive oa(ss);
+        oa << store;
+    }
+    Packed_locus_store loaded;
+    {
+        boost::archive::text_iarchive ia(ss);
+        ia >> loaded;
+    }
+    BOOST_CHECK_EQUAL(loaded.size(), store.size());
+    BOOST_CHECK_EQUAL(loaded.nbytes(), store.nbytes());
+    p.reset(loaded.get(0));
+    check_same_locus_data(*p, geno);
+    p.reset(loaded.get(2));
+    check_same_locus_data(*p, many);
+
+    store.clear();
+    BOOST_CHECK(store.empty());
+    BOOST_CHECK_EQUAL(store.nbytes(), size_t(0));
+}
+
+void file_marker_source_test()
+{
+    // Markers of both files in turn, the same as read file by file
+    set<string> fn;
+    fn.insert("test/data/tiny.tped");
+    fn.insert("test/data/tinyG.slide");
+    File_marker_source source(fn, '?');
+    size_t n = 0;
+    BOOST_FOREACH(string f, fn) {
+        Locus_data_reader<char> reader(f, '?');
+        while (reader.hasData()) {
+            vector<char> v;
+            reader.get_next(v);
+            boost::scoped_ptr<Locus_data<char> > p(source.next());
+            BOOST_REQUIRE(p);
+            check_same_locus_data(*p, Locus_data<char>(v, '?'));
+            n++;
+        }
+    }
+    BOOST_CHECK(n > 0);
+    BOOST_CHECK(source.next() == 0);
+}
+
+struct Failing_preparation {
+    // Throws at marker nfail, counting from 0
+    Failing_preparation(size_t nfail) : n_(0), nfail_(nfail) { }
+    void operator()(Locus_data<char>& d) {
+        if (n_++ == nfail_) {
+            throw Data_length_mismatch_error(n_, 1, d.size());
+        }
+    }
+    size_t n_;
+    size_t nfail_;
+};
+
+void prefetching_marker_source_test()
+{
+    // Same markers in the same order, read ahead or not
+    set<string> fn;
+    fn.insert("test/data/tiny.tped");
+    fn.insert("test/data/tinyG.slide");
+    for (size_t capacity=0; capacity<=3; ++capacity) {
+        File_marker_source files(fn, '?');
+        Prefetching_marker_source source(new File_marker_source(fn, '?'),
+                capacity);
+        while (true) {
+            boost::scoped_ptr<Locus_data<char> > a(files.next());
+            boost::scoped_ptr<Locus_data<char> > b(source.next());
+            BOOST_REQUIRE_EQUAL(a.get() == 0, b.get() == 0);
+            if (not a) {
+                break;
+            }
+            check_same_locus_data(*a, *b);
+        }
+    }
+
+    // An error comes after the markers before it, with its type
+    for (size_t capacity=0; capacity<=3; capacity+=3) {
+        Prefetching_marker_source source(new File_marker_source(fn, '?'),
+                capacity, Failing_preparation(5));
+        for (size_t i=0; i<5; ++i) {
+            boost::scoped_ptr<Locus_data<char> > p(source.next());
+            BOOST_CHECK(p);
+        }
+        BOOST_CHECK_THROW(source.next(), Data_length_mismatch_error);
+    }
+
+    // Stopped before the end
+    Prefetching_marker_source source(new File_marker_source(fn, '?'), 2);
+    boost::scoped_ptr<Locus_data<char> > p(source.next());
+    BOOST_CHECK(p);
+}
+
+template<int n> string skip_and_remove(const string& line)
+{
+    string s;
+    remove_copy_if(line.begin(), line.end(), back_inserter(s),
+            Skip_input_filter<n>());
+    return s;
+}
+
+template<int n> void check_tokenizer(const string& line)
+{
+    const Delimiters white(' ', '\t', '\r');
+    const char* first = line.data();
+    const char* last = first + line.size();
+    vector<char> out(line.size() + 1);
+    char* end = remove_delimiters(skip_chunks(first, last, n, white), last,
+            &out[0], white);
+    BOOST_CHECK_EQUAL(string(&out[0], end), skip_and_remove<n>(line));
+    end = remove_delimiters_generic(skip_chunks(first, last, n, white), last,
+            &out[0], white);
+    BOOST_CHECK_EQUAL(string(&out[0], end), skip_and_remove<n>(line));
+}
+
+void tokenizer_test()
+{
+    // Random lines of all lengths up to a few vectors, the same as with the
+    // input filter
+    const string chars = "AC12 \t\r ?";
+    boost::mt19937 rng(3);
+    for (size_t len=0; len<80; ++len) {
+        for (size_t k=0; k<20; ++k) {
+            string line;
+            for (size_t i=0; i<len; ++i) {
+                line += chars[rng() % chars.size()];
+            }
+            check_tokenizer<0>(line);
+            check_tokenizer<2>(line);
+            check_tokenizer<4>(line);
+        }
+    }
+    check_tokenizer<4>("1 rs1 0 100 A G A A G G A G A A G G A G A A G G A G");
+
+    // Only the given delimiter
+    const string line = "1 1 0\t2 ";
+    vector<char> out(line.size());
+    char* end = remove_delimiters(line.data(), line.data() + line.size(),
+            &out[0], Delimiters(' '));
+    BOOST_CHECK_EQUAL(string(&out[0], end), "110\t2");
+}
+
+void line_reader_test()
+{
+    // Empty lines, a line longer than a chunk and no final newline, both
+    // memory-mapped and decompressed
+    vector<string> lines;
+    lines.push_back("1 rs1 0 100 A G");
+    lines.push_back("");
+    lines.push_back(string(3*BUFFSIZE + 7, 'x'));
+    lines.push_back("");
+    lines.push_back("2");
+    string content;
+    for (size_t i=0; i<lines.size(); ++i) {
+        content += lines[i] + (i + 1 < lines.size() ? "\n" : "");
+    }
+    const string fn = "test/line_reader.test";
+    {
+        ofstream ofs(fn.c_str(), ios::binary);
+        ofs << content;
+    }
+    {
+        ofstream ofs((fn + ".gz").c_str(), ios::binary);
+        boost::iostreams::filtering_ostream out;
+        out.push(boost::iostreams::gzip_compressor());
+        out.push(ofs);
+        out << content;
+    }
+    for (int gz=0; gz<3; ++gz) {   //2: decompressed by another thread
+        Line_reader<char> lr(gz ? fn + ".gz" : fn, gz == 2 ? 2 : 1);
+        for (size_t i=0; i<lines.size(); ++i) {
+            BOOST_REQUIRE(not lr.eof());
+            lr.next();
+            BOOST_CHECK_EQUAL(string(lr.begin(), lr.end()), lines[i]);
+            BOOST_CHECK_EQUAL(lr.size(), lines[i].size());
+        }
+        BOOST_CHECK(lr.eof());
+        BOOST_CHECK_EQUAL(lr.line_count(), lines.size());
+
+        Line_reader<char> skipping(gz ? fn + ".gz" : fn);
+        skipping.skip();
+        skipping.skip();
+        skipping.skip();
+        skipping.next();
+        BOOST_CHECK(skipping.empty());
+        skipping.next();
+        BOOST_CHECK_EQUAL(string(skipping.begin(), skipping.end()), "2");
+        BOOST_CHECK(skipping.eof());
+    }
+    std::remove(fn.c_str());
+    std::remove((fn + ".gz").c_str());
+}
+
+void bgzf_test()
+{
+    // tinyBgzf.tped.gz holds tiny.tped in blocks of 1000 bytes
+    BOOST_CHECK(is_bgzf("test/data/tinyBgzf.tped.gz"));
+    BOOST_CHECK(not is_bgzf("test/data/tiny.bgl.gz"));
+    BOOST_CHECK(not is_bgzf("test/data/tiny.tped"));
+    for (size_t nthreads=1; nthreads<=3; nthreads+=2) {
+        Line_reader<char> plain("test/data/tiny.tped");
+        Line_reader<char> blocked("test/data/tinyBgzf.tped.gz", nthreads);
+        while (not plain.eof()) {
+            BOOST_REQUIRE(not blocked.eof());
+            plain.next();
+            blocked.next();
+            BOOST_CHECK(string(plain.begin(), plain.end())
+                    == string(blocked.begin(), blocked.end()));
+        }
+        BOOST_CHECK(blocked.eof());
+        BOOST_CHECK_EQUAL(blocked.line_count(), plain.line_count());
+    }
+}
+
+void plink_bed_test()
+{
+    // tiny.bed/bim/fam hold the data of tiny.tped/tfam
+    BOOST_CHECK(detect_marker_data_format("test/data/tiny.bed") == plink_bed);
+    BOOST_CHECK(not is_plink_bed("test/data/tiny.tped"));
+    deque<Locus> bed_loci, tped_loci;
+    read_loci(plink_bed, "test/data/tiny.bed", &bed_loci);
+    read_loci(plink_tped, "test/data/tiny.tped", &tped_loci);
+    BOOST_REQUIRE_EQUAL(bed_loci.size(), tped_loci.size());
+    for (size_t i=0; i<bed_loci.size(); ++i) {
+        BOOST_CHECK_EQUAL(bed_loci[i].rs(), tped_loci[i].rs());
+        BOOST_CHECK_EQUAL(bed_loci[i].bp(), tped_loci[i].bp());
+    }
+    Locus_data_reader<char> tped("test/data/tiny.tped", '0');
+    Locus_data_reader<char> alleles("test/data/tiny.bed", '0');
+    Locus_data_reader<char> genotypes("test/data/tiny.bed", '0', 1, genotype);
+    size_t n = 0;
+    while (tped.hasData()) {
+        BOOST_REQUIRE(genotypes.hasData());
+        vector<char> v, a, g;
+        tped.get_next(v);
+        alleles.get_next(a);
+        genotypes.get_next(g);
+        Locus_data<char> expected = Locus_data<char>(v, tped.undef())
+            .condense_alleles_to_genotypes();
+        check_same_locus_data(Locus_data<char>(g, genotypes.undef()), expected);
+        check_same_locus_data(Locus_data<char>(a, alleles.undef())
+                .condense_alleles_to_genotypes(), expected);
+        n++;
+    }
+    BOOST_CHECK_EQUAL(n, bed_loci.size());
+    BOOST_CHECK(not genotypes.hasData());
+
+    // Missing values, padding of the last byte and random access
+    const string fn = "test/plink_bed.test";
+    {
+        ofstream fam((fn + ".fam").c_str());
+        for (int i=0; i<5; ++i) {
+            fam << i << " " << i << " 0 0 1 " << 1 + i%2 << "\n";
+        }
+        ofstream bim((fn + ".bim").c_str());
+        bim << "1\trs1\t0\t100\tA\tG\n" << "2\trs2\t0\t200\tC\tT\n";
+        ofstream bed((fn + ".bed").c_str(), ios::binary);
+        const char bytes[] = {0x6c, 0x1b, 0x01, char(0xe4), 0x02, char(0xff), 0x00};
+        bed.write(bytes, sizeof(bytes));
+    }
+    Bed_reader reader(fn + ".bed");
+    BOOST_CHECK_EQUAL(reader.nmarker(), size_t(2));
+    BOOST_CHECK_EQUAL(reader.nsubject(), size_t(5));
+    vector<char> v;
+    reader.seek(1);
+    reader.next_genotypes(v, '0');
+    BOOST_CHECK_EQUAL(string(v.begin(), v.end()), "00002");
+    BOOST_CHECK(not reader.hasNext());
+    reader.seek(0);
+    reader.next_alleles(v, '0');
+    BOOST_CHECK_EQUAL(string(v.begin(), v.end()), "AA00AGGGAG");
+    Locus_data<char> condensed = Locus_data<char>(v, '0')
+        .condense_alleles_to_genotypes();
+    reader.seek(0);
+    reader.next_genotypes(v, '0');  //A and G 4 times each: A is minor
+    BOOST_CHECK_EQUAL(string(v.begin(), v.end()), "2?101");
+    check_same_locus_data(Locus_data<char>(v, '?'), condensed);
+    std::remove((fn + ".fam").c_str());
+    std::remove((fn + ".bim").c_str());
+    std::remove((fn + ".bed").c_str());
+}
+
+void locus_data_reader_loci_test()
+{
+    // The loci got along with the data are those of read_loci, and the data
+    // are the same as without them
+    const string fn[] = {"test/data/tiny.tped", "test/data/tiny.bgl.gz",
+        "test/data/tinyG.slide"};
+    for (size_t k=0; k<3; ++k) {
+        datafile_format dff = detect_marker_data_format(fn[k]);
+        deque<Locus> loci;
+        read_loci(dff, fn[k], &loci);
+        Locus_data_reader<char> reader(fn[k], '?', 1, allelic, dff);
+        Locus_data_reader<char> plain(fn[k]);
+        Locus_data_reader<char> skipping(fn[k]);
+        vector<char> v, w;
+        Locus locus(1);
+        size_t n = 0;
+        while (reader.get_next(&v, &locus)) {
+            BOOST_REQUIRE(n < loci.size());
+            BOOST_CHECK_EQUAL(locus.id(), loci[n].id());
+            BOOST_CHECK_EQUAL(locus.rs(), loci[n].rs());
+            BOOST_CHECK(locus.chr() == loci[n].chr());
+            BOOST_CHECK_EQUAL(locus.bp(), loci[n].bp());
+            BOOST_CHECK_EQUAL(locus.cm(), loci[n].cm());
+            plain.get_next(w);
+            BOOST_CHECK(v == w);
+            BOOST_CHECK(skipping.get_next(0, 0));
+            locus = Locus(++n + 1);
+        }
+        BOOST_CHECK_EQUAL(n, loci.size());
+        BOOST_CHECK(not skipping.get_next(0, 0));
+    }
+}
+
 test_suite* init_unit_test_suite( int argc, char* argv[] )
 {
     test_suite *test = BOOST_TEST_SUITE("Functions and classes from src/gwas");
@@ -109,6 +494,14 @@ test_suite* init_unit_test_suite( int argc, char* argv[] )
     test->add(BOOST_TEST_CASE(&read_individuals_from_tfam_test));
     test->add(BOOST_TEST_CASE(&read_individuals_test));
     test->add(BOOST_TEST_CASE(&determine_phenotype_domain_test));
+    test->add(BOOST_TEST_CASE(&packed_locus_store_test));
+    test->add(BOOST_TEST_CASE(&file_marker_source_test));
+    test->add(BOOST_TEST_CASE(&prefetching_marker_source_test));
+    test->add(BOOST_TEST_CASE(&line_reader_test));
+    test->add(BOOST_TEST_CASE(&tokenizer_test));
+    test->add(BOOST_TEST_CASE(&bgzf_test));
+    test->add(BOOST_TEST_CASE(&plink_bed_test));
+    test->add(BOOST_TEST_CASE(&locus_data_reader_loci_test));
 
     return test;
 }
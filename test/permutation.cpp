@@ -7,11 +7,15 @@
 #include "detail/config.hpp"
 #include "permutation/permutation.hpp"
 #include "permutation/fast_count.hpp"
+#include "permutation/philox.hpp"
+#include "permutation/recode.hpp"
 #include "test.hpp"
 
 #include "detail/parameter.hpp"
 #include "detail/pair.hpp"
 
+#include <algorithm>
+#include <sstream>
 #include <vector>
 #include <valarray>
 
@@ -65,11 +69,451 @@ void git_test()
     }
 }
 
+void perm_matrix_test()
+{
+    // A matrix continuing another one must hold the same permutations as a
+    // single matrix created with the same seed
+    unsigned short d[] = {1, 1, 0, 0, 0, 1, 0, 0, 1, 0};
+    vector<unsigned short> trait(&d[0], &d[0]+10);
+    Permutation pp1(7);
+    Perm_matrix<unsigned short> whole(50, pp1, trait);
+    Permutation pp2(7);
+    Perm_matrix<unsigned short> first(20, pp2, trait);
+    Perm_matrix<unsigned short> second(30, pp2, first);
+
+    BOOST_CHECK_EQUAL(second.nperm(), size_t(30));
+    BOOST_CHECK_EQUAL(second.nsubject(), size_t(10));
+    BOOST_CHECK(second.hasBitmat());
+    for (size_t i=0; i<20; ++i) {
+        BOOST_CHECK(first.permutation(i) == whole.permutation(i));
+    }
+    for (size_t i=0; i<30; ++i) {
+        BOOST_CHECK(second.permutation(i) == whole.permutation(20 + i));
+    }
+}
+
+void rem_test()
+{
+    // Updating the counts of a similar bitset with REM must give the same
+    // counts as GIT, here for 8-bit counts and enough rows for blocking
+    size_t n = 200;
+    vector<unsigned char> trait(n, 0);
+    for (size_t i=0; i<n; i+=2) {
+        trait[i] = 1;
+    }
+    Permutation pp;
+    size_t nperm = 5000;
+    Perm_matrix<unsigned char> pmat(nperm, pp, trait, false);
+    boost::dynamic_bitset<> b(n), bb(n);
+    for (size_t k=0; k<n; k+=3) {
+        b[k] = 1;
+    }
+    for (size_t k=0; k<n; k+=5) {
+        bb[k] = 1;
+    }
+    valarray<unsigned char> expected((unsigned char) 0, nperm);
+    git(pmat, index_code(b), expected);
+    valarray<unsigned char> res((unsigned char) 0, nperm);
+    git(pmat, index_code(bb), res);
+    rem(pmat, b, bb, res);
+    BOOST_CHECK((res == expected).min());
+    BOOST_CHECK(expected.max() <= b.count());
+}
+
+void fast_count_test()
+{
+    // The booster must give the counts of GIT for each dummy code, no matter
+    // which method it chooses, and the result of a buffered code must stay
+    // valid until its slot is reused
+    size_t n = 150;
+    vector<unsigned short> trait(n, 0);
+    for (size_t i=0; i<n; i+=2) {
+        trait[i] = 1;
+    }
+    Permutation pp;
+    size_t nperm = 300;
+    boost::shared_ptr<Perm_matrix<unsigned short> > pmat(
+            new Perm_matrix<unsigned short>(nperm, pp, trait, true));
+    Cost_model costs;
+    costs.bar = 1.0/6.0;    //such that REM beats BAR below
+    Fast_count<unsigned short> booster(pmat, 2, costs);
+    BOOST_CHECK(booster.empty_buffer());
+
+    size_t steps[] = {9, 9, 4, 1, 7, 2, 3};
+    const valarray<unsigned short>* previous = 0;
+    valarray<unsigned short> previousExpected;
+    for (size_t j=0; j<7; ++j) {
+        vector<char> data(n, 'a');
+        for (size_t k=0; k<n; k+=steps[j]) {
+            data[k] = 'b';
+        }
+        if (j == 1) {
+            data[1] = 'b';  //one bit more than before
+        }
+        booster.code().assign_dummy_code(data.begin(), data.end(), 'b');
+        BOOST_CHECK(booster.code().get() ==
+                dummy_code<char>(data.begin(), data.end(), 'b'));
+        size_t cnt = booster.code().count();
+        booster.find_similar_bitset_in_buffer(booster.code(), cnt);
+        if (j == 1) {
+            BOOST_CHECK(booster.hasMemoized());
+        }
+        booster.count();
+
+        valarray<unsigned short> expected((unsigned short) 0, nperm);
+        git(*pmat, index_code(booster.code().get()), expected);
+        BOOST_CHECK((booster.result() == expected).min());
+        if (previous != 0) {
+            BOOST_CHECK((*previous == previousExpected).min());
+        }
+        previous = &booster.result();
+        previousExpected = expected;
+        booster.add_to_buffer();
+    }
+    BOOST_CHECK(not booster.empty_buffer());
+}
+
+void similarity_index_test()
+{
+    size_t n = 2000;
+    size_t nslot = 500;
+    Similarity_index index(nslot, (n + 63)/64);
+    BOOST_CHECK(not index.empty());
+    BOOST_CHECK_EQUAL(index.nbands(), size_t(16));
+
+    // Random bitsets, each in one slot, and one bitset close to slot 123
+    Permutation pp;
+    vector<Bitset_with_count> codes(nslot);
+    vector<char> v(n, 0);
+    fill(v.begin(), v.begin() + n/3, 1);
+    for (size_t s=0; s<nslot; ++s) {
+        pp.shuffle(&v[0], n);
+        boost::dynamic_bitset<> b(n);
+        for (size_t i=0; i<n; ++i) {
+            b[i] = v[i] != 0;
+        }
+        codes[s] = b;
+        index.insert(s, codes[s].words());
+    }
+    boost::dynamic_bitset<> b = codes[123].get();
+    for (size_t i=0; i<10; ++i) {
+        b.flip(i*150);
+    }
+    Bitset_with_count query(b);
+    vector<size_t> cand;
+    index.candidates(query.words(), cand);
+    BOOST_CHECK(find(cand.begin(), cand.end(), 123) != cand.end());
+    BOOST_CHECK(cand.size() < nslot/10);
+
+    // Erased or replaced slots are not listed anymore
+    index.erase(123);
+    index.candidates(query.words(), cand);
+    BOOST_CHECK(find(cand.begin(), cand.end(), 123) == cand.end());
+    index.insert(7, query.words());
+    index.candidates(query.words(), cand);
+    BOOST_CHECK(find(cand.begin(), cand.end(), 7) != cand.end());
+    index.insert(7, codes[7].words());
+    index.candidates(query.words(), cand);
+    BOOST_CHECK(find(cand.begin(), cand.end(), 7) == cand.end());
+}
+
+void long_tail_test()
+{
+    // A code similar to one buffered long ago (beyond the linearly searched
+    // part of the tail) must be found via the index and be counted right,
+    // even if many recent codes share all its indexed bands with the query
+    size_t n = 1000;
+    vector<unsigned short> trait(n, 0);
+    for (size_t i=0; i<n; i+=2) {
+        trait[i] = 1;
+    }
+    Permutation pp;
+    size_t nperm = 100;
+    boost::shared_ptr<Perm_matrix<unsigned short> > pmat(
+            new Perm_matrix<unsigned short>(nperm, pp, trait, false));
+    size_t tail = 3*Fast_count<unsigned short>::scan_size;
+    Fast_count<unsigned short> booster(pmat, tail);
+
+    vector<char> data(n, 'a');
+    for (size_t k=0; k<n; k+=11) {
+        data[k] = 'b';
+    }
+    vector<char> other(n, 'b');     //too many bits to be worth a look
+    vector<char> decoy(data);       //differs from data in the first band only
+    fill(decoy.begin(), decoy.begin() + 64, 'b');
+    size_t ndecoy = 40;
+    for (size_t j=0; j<tail-10; ++j) {
+        const vector<char>& d = (j == 0) ? data : 
+            (j < tail-10-ndecoy ? other : decoy);
+        booster.code().assign_dummy_code(d.begin(), d.end(), 'b');
+        booster.find_similar_bitset_in_buffer(booster.code(),
+                booster.code().count());
+        booster.count();
+        booster.add_to_buffer();
+    }
+    data[1] = 'b';
+    booster.code().assign_dummy_code(data.begin(), data.end(), 'b');
+    size_t dist = booster.find_similar_bitset_in_buffer(booster.code(),
+            booster.code().count());
+    BOOST_CHECK(booster.hasMemoized());
+    BOOST_CHECK_EQUAL(dist, size_t(1));
+    booster.count();
+    valarray<unsigned short> expected((unsigned short) 0, nperm);
+    git(*pmat, index_code(booster.code().get()), expected);
+    BOOST_CHECK((booster.result() == expected).min());
+}
+
+void cost_model_test()
+{
+    // Written costs are read back, bad entries are rejected
+    Cost_model costs;
+    costs.bar = 0.02;
+    costs.rem_fixed = 3;
+    stringstream ss;
+    costs.write(ss);
+    Cost_model read;
+    read.read(ss);
+    BOOST_CHECK_CLOSE(read.bar, 0.02, 1e-6);
+    BOOST_CHECK_CLOSE(read.rem_fixed, 3.0, 1e-6);
+    BOOST_CHECK_CLOSE(read.bsl_per_index, costs.bsl_per_index, 1e-6);
+    stringstream bad("bar 0.1\nfoo 2\n");
+    BOOST_CHECK_THROW(read.read(bad), std::runtime_error);
+
+    // Calibrated costs are positive, and the counts do not depend on them
+    size_t n = 400;
+    vector<unsigned short> trait(n, 0);
+    for (size_t i=0; i<n; i+=2) {
+        trait[i] = 1;
+    }
+    Permutation pp;
+    size_t nperm = 500;
+    boost::shared_ptr<Perm_matrix<unsigned short> > pmat(
+            new Perm_matrix<unsigned short>(nperm, pp, trait, true, true));
+    Cost_model calibrated = calibrate(*pmat);
+    BOOST_CHECK(calibrated.bar > 0);
+    BOOST_CHECK(calibrated.bsl_fixed + calibrated.bsl_per_index > 0);
+
+    Fast_count<unsigned short> booster(pmat, 10, calibrated);
+    for (size_t step=1; step<n; step*=3) {
+        vector<char> data(n, 'a');
+        for (size_t k=0; k<n; k+=step) {
+            data[k] = 'b';
+        }
+        booster.code().assign_dummy_code(data.begin(), data.end(), 'b');
+        booster.find_similar_bitset_in_buffer(booster.code(),
+                booster.code().count());
+        booster.count();
+        valarray<unsigned short> expected((unsigned short) 0, nperm);
+        git(*pmat, index_code(booster.code().get()), expected);
+        BOOST_CHECK((booster.result() == expected).min());
+        booster.add_to_buffer();
+    }
+}
+
+void bsl_test()
+{
+    // Bit-sliced counting must give the same counts as GIT and BAR, also for
+    // numbers of permutations not filling the last word or cache line
+    size_t n = 300;
+    vector<unsigned short> trait(n, 0);
+    for (size_t i=0; i<n; i+=3) {
+        trait[i] = 1;
+    }
+    Permutation pp;
+    size_t nperms[] = {1, 64, 700};
+    size_t steps[] = {1, 2, 7, 50, 299};
+    for (size_t i=0; i<3; ++i) {
+        Perm_matrix<unsigned short> pmat(nperms[i], pp, trait, true, true);
+        BOOST_CHECK(pmat.hasBitslice());
+        for (size_t j=0; j<5; ++j) {
+            boost::dynamic_bitset<> b(n);
+            for (size_t k=0; k<n; k+=steps[j]) {
+                b[k] = 1;
+            }
+            vector<int> idx = index_code(b);
+            valarray<unsigned short> expected((unsigned short) 0, nperms[i]);
+            git(pmat, idx, expected);
+            valarray<unsigned short> res((unsigned short) 0, nperms[i]);
+            bsl(pmat, idx, res);
+            BOOST_CHECK((res == expected).min());
+            bar(pmat, b, res);
+            BOOST_CHECK((res == expected).min());
+        }
+    }
+}
+
+void philox_test()
+{
+    // Known answers of the Philox4x32-10 reference implementation
+    boost::uint32_t ctr[4] = {0, 0, 0, 0};
+    boost::uint32_t key[2] = {0, 0};
+    boost::uint32_t out[4];
+    philox4x32(ctr, key, out);
+    BOOST_CHECK_EQUAL(out[0], 0x6627e8d5u);
+    BOOST_CHECK_EQUAL(out[1], 0xe169c58du);
+    BOOST_CHECK_EQUAL(out[2], 0xbc57ac4cu);
+    BOOST_CHECK_EQUAL(out[3], 0x9b00dbd8u);
+    boost::uint32_t ctr2[4] = {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff};
+    boost::uint32_t key2[2] = {0xffffffff, 0xffffffff};
+    philox4x32(ctr2, key2, out);
+    BOOST_CHECK_EQUAL(out[0], 0x408f276du);
+    BOOST_CHECK_EQUAL(out[1], 0x41c83b0eu);
+    BOOST_CHECK_EQUAL(out[2], 0xa20bc7c6u);
+    BOOST_CHECK_EQUAL(out[3], 0x6d5451fdu);
+
+    // With a counter-based generator, permutation i depends only on seed and
+    // i, so matrices can be built in any order and pieces
+    size_t n = 50;
+    vector<unsigned short> trait(n, 0);
+    for (size_t i=0; i<n; i+=4) {
+        trait[i] = 1;
+    }
+    Permutation pp(4711, true);
+    Perm_matrix<unsigned short> whole(30, pp, trait);
+    BOOST_CHECK_EQUAL(pp.next_index(), 30u);
+
+    Permutation p1(4711, true);
+    Perm_matrix<unsigned short> first(10, p1, trait);
+    Perm_matrix<unsigned short> second(20, p1, first);
+    Permutation p2(4711, true);
+    p2.set_next_index(10);
+    Perm_matrix<unsigned short> slice(20, p2, trait);
+    for (size_t i=0; i<10; ++i) {
+        BOOST_CHECK(first.permutation(i) == whole.permutation(i));
+    }
+    for (size_t i=0; i<20; ++i) {
+        BOOST_CHECK(second.permutation(i) == whole.permutation(10 + i));
+        BOOST_CHECK(slice.permutation(i) == whole.permutation(10 + i));
+    }
+
+    // Each permutation still is a permutation of the trait
+    vector<unsigned short> v = whole.permutation(29);
+    BOOST_CHECK(v != trait);
+    sort(v.begin(), v.end());
+    vector<unsigned short> sorted(trait);
+    sort(sorted.begin(), sorted.end());
+    BOOST_CHECK(v == sorted);
+}
+
+void state_test()
+{
+    // A generator continues from a saved state exactly as the original one
+    size_t n = 50;
+    vector<unsigned short> trait(n, 0);
+    for (size_t i=0; i<n; i+=3) {
+        trait[i] = 1;
+    }
+    for (int counterBased=0; counterBased<2; ++counterBased) {
+        Permutation pp(4711, counterBased);
+        Perm_matrix<unsigned short> first(10, pp, trait);
+        vector<char> state = pp.state();
+        Perm_matrix<unsigned short> second(20, pp, trait);
+
+        Permutation other(4711, counterBased);
+        other.set_state(state);
+        Perm_matrix<unsigned short> resumed(20, other, trait);
+        for (size_t i=0; i<20; ++i) {
+            BOOST_CHECK(resumed.permutation(i) == second.permutation(i));
+        }
+        BOOST_CHECK_EQUAL(other.next_index(), pp.next_index());
+    }
+    Permutation pp;
+    BOOST_CHECK_THROW(pp.set_state(vector<char>(3)), std::invalid_argument);
+}
+
+void compact_test()
+{
+    // A compact matrix holds the same permutations as a dense one and all
+    // methods count the same on it
+    size_t n = 333;
+    vector<unsigned char> trait(n, 0);
+    for (size_t i=0; i<n; i+=3) {
+        trait[i] = 1;
+    }
+    size_t nperm = 200;
+    Permutation p1, p2;
+    Perm_matrix<unsigned char> dense(nperm, p1, trait, true, true);
+    Perm_matrix<unsigned char> compact(nperm, p2, trait, true, false, true);
+    BOOST_CHECK(compact.isCompact());
+    BOOST_CHECK(compact.hasBitslice());
+    BOOST_CHECK(not compact.hasBitmat());
+    BOOST_CHECK_EQUAL(compact.nperm(), nperm);
+    BOOST_CHECK_EQUAL(compact.nsubject(), n);
+    for (size_t i=0; i<nperm; i+=13) {
+        BOOST_CHECK(compact.permutation(i) == dense.permutation(i));
+    }
+    Perm_matrix<unsigned char> next(50, p2, compact);
+    BOOST_CHECK(next.isCompact());
+
+    boost::dynamic_bitset<> b(n), bb(n);
+    for (size_t k=0; k<n; k+=5) {
+        b[k] = 1;
+    }
+    bb = b;
+    bb.flip(1);
+    bb.flip(10);
+    bb.flip(332);
+    vector<int> idx = index_code(b);
+    valarray<unsigned char> expected((unsigned char) 0, nperm);
+    git(dense, idx, expected);
+    valarray<unsigned char> res((unsigned char) 0, nperm);
+    git(compact, idx, res);
+    BOOST_CHECK((res == expected).min());
+    bsl(compact, idx, res);
+    BOOST_CHECK((res == expected).min());
+
+    valarray<unsigned char> memo((unsigned char) 0, nperm);
+    git(dense, index_code(bb), memo);
+    res = memo;
+    rem(compact, b, bb, res);
+    BOOST_CHECK((res == expected).min());
+
+    // The booster only uses BSL and REM
+    boost::shared_ptr<Perm_matrix<unsigned char> > pmat(
+            new Perm_matrix<unsigned char>(nperm, p2, trait, true, false, true));
+    Fast_count<unsigned char> booster(pmat, 10);
+    for (size_t j=0; j<2; ++j) {
+        booster.code() = (j == 0 ? bb : b);
+        booster.find_similar_bitset_in_buffer(booster.code(),
+                booster.code().count());
+        booster.count();
+        valarray<unsigned char> exp((unsigned char) 0, nperm);
+        git(*pmat, index_code(booster.code().get()), exp);
+        BOOST_CHECK((booster.result() == exp).min());
+        booster.add_to_buffer();
+    }
+
+    // Memory per permutation, used to size blocks (--mem-limit)
+    typedef Perm_matrix<unsigned short> pmat_t;
+    BOOST_CHECK_EQUAL(pmat_t::bytes_per_permutation(1000, false), 2000u);
+    BOOST_CHECK_EQUAL(pmat_t::bytes_per_permutation(1000, true, true),
+            2000u + 128u + 125u);
+    BOOST_CHECK_EQUAL(pmat_t::bytes_per_permutation(1000, true, true, true),
+            125u);
+    BOOST_CHECK_EQUAL(Fast_count<unsigned short>::bytes_per_permutation(100),
+            202u);
+
+    // Only 0/1 traits can be bit-packed
+    trait[0] = 2;
+    BOOST_CHECK_THROW(Perm_matrix<unsigned char>(10, p1, trait, true, false,
+                true), std::invalid_argument);
+}
+
 test_suite* init_unit_test_suite( int argc, char* argv[] )
 {
     test_suite *test = BOOST_TEST_SUITE("Functions and classes from src/permutation");
 
     test->add(BOOST_TEST_CASE(&git_test));
+    test->add(BOOST_TEST_CASE(&perm_matrix_test));
+    test->add(BOOST_TEST_CASE(&rem_test));
+    test->add(BOOST_TEST_CASE(&bsl_test));
+    test->add(BOOST_TEST_CASE(&fast_count_test));
+    test->add(BOOST_TEST_CASE(&similarity_index_test));
+    test->add(BOOST_TEST_CASE(&long_tail_test));
+    test->add(BOOST_TEST_CASE(&cost_model_test));
+    test->add(BOOST_TEST_CASE(&philox_test));
+    test->add(BOOST_TEST_CASE(&state_test));
+    test->add(BOOST_TEST_CASE(&compact_test));
 
     return test;
 }
@@ -11,6 +11,7 @@
 #include <boost/archive/text_iarchive.hpp>
 
 #include "individual.hpp"
+#include "gwas/checkpoint.hpp"
 #include "gwas/locus.hpp"
 #include "gwas/gwas.hpp"
 #include "test.hpp"
@@ -115,6 +116,41 @@ void gwas_test()
     BOOST_CHECK_EQUAL(orig.sample_size(), loaded.sample_size());
 }
 
+void checkpoint_test()
+{
+    const string filename = "test/checkpoint.test";
+    deque<double> t;
+    t.push_back(1.5);
+    t.push_back(4.0);
+    Checkpoint orig;
+    orig.nperm_total = 1000;
+    orig.nperm_block = 100;
+    orig.seed = 42;
+    orig.m = 2;
+    orig.perm_todo = 700;
+    orig.rng.assign(5, 'x');
+    orig.exceed = statistic::Exceedance_counts(t, 10);
+    vector<double> tmax(3, 2.0);
+    orig.exceed.add(tmax);
+    write_checkpoint(orig, filename);
+
+    Checkpoint loaded;
+    BOOST_CHECK(read_checkpoint(filename, loaded));
+    BOOST_CHECK(loaded.isSameRun(orig));
+    BOOST_CHECK_EQUAL(loaded.perm_todo, orig.perm_todo);
+    BOOST_CHECK(loaded.rng == orig.rng);
+    BOOST_CHECK_EQUAL(loaded.exceed.nperm(), 3u);
+    BOOST_CHECK_EQUAL(loaded.exceed.count(1.5), 3u);
+    BOOST_CHECK_EQUAL(loaded.exceed.count(4.0), 0u);
+    loaded.seed = 43;
+    BOOST_CHECK(not loaded.isSameRun(orig));
+
+    // No temporary file is left, and a missing file is no checkpoint
+    BOOST_CHECK(not ifstream((filename + ".tmp").c_str()));
+    std::remove(filename.c_str());
+    BOOST_CHECK(not read_checkpoint(filename, loaded));
+}
+
 test_suite* init_unit_test_suite( int argc, char* argv[] )
 {
     test_suite *test = BOOST_TEST_SUITE("Functions and classes from src/detail");
@@ -123,6 +159,7 @@ test_suite* init_unit_test_suite( int argc, char* argv[] )
     test->add(BOOST_TEST_CASE(&individual_test));
     test->add(BOOST_TEST_CASE(&locus_test));
     test->add(BOOST_TEST_CASE(&gwas_test));
+    test->add(BOOST_TEST_CASE(&checkpoint_test));
 
     return test;
 }
@@ -4,6 +4,10 @@
 // file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt.)
 
 #define PERMORY_TEST statictic_test
+#include "gwas/gwas.hpp"
+#include "statistical/dichotom.hpp"
+#include "statistical/exceedance.hpp"
+#include "statistical/gpd.hpp"
 #include "statistical/pvalue.hpp"
 #include "statistical/quantitative.hpp"
 #include "test.hpp"
@@ -15,6 +19,8 @@
 
 #include <vector>
 
+#include <boost/random/mersenne_twister.hpp>
+
 using namespace std;
 using namespace boost;
 using namespace unit_test;
@@ -77,6 +83,110 @@ void single_step_counts_test()
 }
 
 
+void pvalue_interval_test()
+{
+    // Wilson interval for 0 and 50 out of 100 at about 95%
+    std::pair<double, double> ci = pvalue_interval(0, 100, 0.95);
+    BOOST_CHECK_SMALL(ci.first, 1e-12);
+    BOOST_CHECK_CLOSE(ci.second, 0.0370, 0.5);
+    ci = pvalue_interval(50, 100, 0.95);
+    BOOST_CHECK_CLOSE(ci.first, 0.4038, 0.5);
+    BOOST_CHECK_CLOSE(ci.second, 0.5962, 0.5);
+
+    // Resolved by the width of the intervals only, even if they are far
+    // from alpha = 0.05
+    deque<size_t> counts;
+    counts.push_back(0);
+    counts.push_back(50);
+    BOOST_CHECK(not pvalues_resolved(counts, 1000, 0.05, 0.0));
+    BOOST_CHECK(not pvalues_resolved(counts, 1000, 0.05, 0.1));
+    BOOST_CHECK(pvalues_resolved(counts, 1000, 0.05, 1.0));
+    BOOST_CHECK(pvalues_resolved(counts, 1000000, 0.05, 0.1));
+    counts.push_back(500);
+    BOOST_CHECK(not pvalues_resolved(counts, 1000, 0.05, 1.0));
+}
+
+void exceedance_counts_test()
+{
+    // Same counts as single_step_counts, whether added at once or by block
+    deque<double> t;
+    t.push_back(3.5); t.push_back(0.5); t.push_back(2); t.push_back(3.5);
+    std::vector<double> perm;
+    for (size_t i=0; i<1000; ++i) {
+        perm.push_back(double((i*7919) % 1000)/250);
+    }
+    deque<double> sorted(perm.begin(), perm.end());
+    sort(sorted.begin(), sorted.end());
+    deque<size_t> expected = single_step_counts(t, sorted);
+
+    Exceedance_counts all(t, 10);
+    std::vector<double> v(perm);
+    all.add(v);
+    Exceedance_counts first(t, 10);
+    Exceedance_counts second(t, 10);
+    for (size_t i=0; i<perm.size(); i+=100) {
+        std::vector<double> block(perm.begin() + i, perm.begin() + i + 100);
+        (i < 500 ? first : second).add(block);
+    }
+    Exceedance_counts merged = Exceedance_merge()(first, second);
+    BOOST_CHECK_EQUAL(all.nperm(), size_t(1000));
+    BOOST_CHECK_EQUAL(merged.nperm(), size_t(1000));
+    for (size_t i=0; i<t.size(); ++i) {
+        BOOST_CHECK_EQUAL(all.count(t[i]), expected[i]);
+        BOOST_CHECK_EQUAL(merged.count(t[i]), expected[i]);
+    }
+    BOOST_CHECK_THROW(all.count(1.0), std::invalid_argument);
+
+    // Quantiles: exact among the 10 largest, else within 0.5%
+    BOOST_CHECK_EQUAL(merged.largest().size(), size_t(10));
+    BOOST_CHECK_EQUAL(merged.largest().back(), sorted.back());
+    BOOST_CHECK_EQUAL(merged.quantile(0.995), sorted[995]);
+    BOOST_CHECK_CLOSE(merged.quantile(0.5), sorted[500], 0.5);
+
+    // The memory (as charged by --mem-limit) does not grow with the number
+    // of permutations beyond the largest tail kept
+    size_t m = 1000;
+    size_t small = Exceedance_counts::memory_use(m,
+            exceedance_tail_size(0.05, 10000));
+    size_t large = Exceedance_counts::memory_use(m,
+            exceedance_tail_size(0.05, size_t(100000000)));
+    BOOST_CHECK_EQUAL(large, Exceedance_counts::memory_use(m,
+                exceedance_tail_size(0.05, size_t(1) << 40)));
+    BOOST_CHECK(large < small + (size_t(1) << 20)*sizeof(double));
+    BOOST_CHECK(large < size_t(100000000)*sizeof(double)/10);
+}
+
+void gpd_tail_test()
+{
+    // Exact quantiles of the standard exponential, which is a GPD with
+    // shape 0 and scale 1 above any threshold
+    size_t n = 100000;
+    deque<double> tperm(n);
+    for (size_t i=0; i<n; ++i) {
+        tperm[i] = -std::log(1 - (i + 0.5)/n);
+    }
+    Gpd_tail tail(tperm, n, 1);
+    BOOST_CHECK(tail.isFitted());
+    BOOST_CHECK_EQUAL(tail.nexceed(), size_t(250));
+    BOOST_CHECK_SMALL(tail.shape(), 0.05);
+    BOOST_CHECK_CLOSE(tail.scale(), 1.0, 5.0);
+
+    // Extrapolation far beyond the largest permutation
+    double t = std::log(1e7);
+    BOOST_CHECK_CLOSE(tail.pvalue(t), 1e-7, 30.0);
+    std::pair<double, double> ci = tail.interval(t);
+    BOOST_CHECK(ci.first <= tail.pvalue(t) && tail.pvalue(t) <= ci.second);
+    BOOST_CHECK(ci.first < 1e-7 && 1e-7 < ci.second);
+
+    // The largest values suffice
+    deque<double> largest(tperm.end() - 251, tperm.end());
+    BOOST_CHECK_EQUAL(Gpd_tail(largest, n, 1).pvalue(t), tail.pvalue(t));
+
+    // Too few permutations
+    tperm.resize(100);
+    BOOST_CHECK(not Gpd_tail(tperm, tperm.size()).isFitted());
+}
+
 Individual make_individual(double phenotype) {
     Individual individual(0);
     Record record(phenotype);
@@ -441,15 +551,96 @@ void teststat_test() {
     }
 }
 
+//
+// Dichotom with 8-bit counts gives the same test statistics and max
+// permutation statistics as with the default 16 bits, here for more than
+// 255 subjects (the counts are bounded by the cases). A is 2 for allelic
+// data (each subject twice), else 1.
+//
+template<uint L, size_t A> void check_narrow_dichotom(const string& values)
+{
+    Parameter par;
+    size_t nsubject = 600;
+    vector<Individual> sample(Permory::case_control_sample(nsubject, 0.8));
+    vector<Individual> trait;
+    size_t ncase = 0;
+    BOOST_FOREACH(const Individual& ind, sample) {
+        ncase += ind.isAffected();
+        for (size_t k=0; k<A; ++k) {
+            trait.push_back(ind);
+        }
+    }
+    BOOST_REQUIRE(A*ncase <= 255 && trait.size() > 255);
+
+    boost::mt19937 rng(4711);
+    vector<Locus_data<char> > data;
+    for (size_t i=0; i<30; ++i) {
+        vector<char> v(trait.size());
+        for (size_t j=0; j<v.size(); ++j) {     //rare and common markers
+            bool isMinor = rng() % (i%3 == 0 ? 20 : 3) == 0;
+            v[j] = values[isMinor ? 1 + rng() % (values.size() - 1) : 0];
+        }
+        data.push_back(Locus_data<char>(v, par.undef_allele_code));
+        if (A == 1) {
+            data.back().add_to_domain(create_domain<char>());
+        }
+    }
+
+    // GIT, BAR, BSL, REM and compact permutations
+    const bool bar[] = {false, true, false, false, false};
+    const bool bsl[] = {false, false, true, false, true};
+    const bool compact[] = {false, false, false, false, true};
+    const size_t tail[] = {0, 0, 0, 100, 0};
+    bool savedBar = par.useBar, savedBsl = par.useBsl;
+    bool savedCompact = par.compactPerm;
+    size_t savedTail = par.tail_size, savedBlock = par.nperm_block;
+    set<Test_type> savedTests = par.tests;
+    par.tests.insert(trend);    //genotypes
+    par.tests.insert(chisq);    //alleles
+    for (size_t m=0; m<5; ++m) {
+        par.useBar = bar[m];
+        par.useBsl = bsl[m];
+        par.compactPerm = compact[m];
+        par.tail_size = tail[m];
+        par.nperm_block = 200;
+        Permory::permutation::Permutation pa(99), pb(99);
+        Dichotom<2, L, unsigned char> narrow(par, trait.begin(), trait.end(), &pa);
+        Dichotom<2, L> wide(par, trait.begin(), trait.end(), &pb);
+        BOOST_FOREACH(const Locus_data<char>& d, data) {
+            BOOST_CHECK(narrow.test(d) == wide.test(d));
+            narrow.permutation_test(d);
+            wide.permutation_test(d);
+        }
+        vector<double> tmax(narrow.tmax_begin(), narrow.tmax_end());
+        BOOST_CHECK(tmax == vector<double>(wide.tmax_begin(), wide.tmax_end()));
+        BOOST_CHECK(*max_element(tmax.begin(), tmax.end()) > 0);
+    }
+    par.useBar = savedBar;
+    par.useBsl = savedBsl;
+    par.compactPerm = savedCompact;
+    par.tail_size = savedTail;
+    par.nperm_block = savedBlock;
+    par.tests = savedTests;
+}
+
+void narrow_counts_test()
+{
+    check_narrow_dichotom<3, 1>("012");     //genotypes
+    check_narrow_dichotom<2, 2>("AC");      //alleles
+}
 
 test_suite* init_unit_test_suite( int argc, char* argv[] )
 {
     test_suite *test = BOOST_TEST_SUITE("Functions and classes from src/statistical");
 
     test->add(BOOST_TEST_CASE(&single_step_counts_test));
+    test->add(BOOST_TEST_CASE(&pvalue_interval_test));
+    test->add(BOOST_TEST_CASE(&exceedance_counts_test));
+    test->add(BOOST_TEST_CASE(&gpd_tail_test));
     test->add(BOOST_TEST_CASE(&quantitative_test));
     test->add(BOOST_TEST_CASE(&quantitative_missings_test));
     test->add(BOOST_TEST_CASE(&teststat_test));
+    test->add(BOOST_TEST_CASE(&narrow_counts_test));
 
     return test;
 }